@@ -1,6 +1,9 @@
 #include "Database3.hxx"
 
+#include <algorithm>
 #include <fstream>
+#include <optional>
+#include <thread>
 
 #include "ansi.hxx"
 #include "command-utils.hxx"
@@ -36,6 +39,14 @@ void log_symbols(const Artifact& artifact, const SymbolExtractionStatus& status)
 
   LOG(error && status.linker_script) << style::red_fg << "Linker scripts are not supported" << style::reset;
 
+  for(const ArchiveMemberSymbols& member : status.members) {
+    LOG(trace) << style::yellow_fg << "Member " << style::reset << member.member;
+  }
+
+  for(const std::string& err : status.errors) {
+    LOG(error) << style::red_fg << "Error: " << style::reset << err;
+  }
+
   for(const ProcessResult& process : status.processes) {
     LOG(error && failed(process)) << process.command;
     LOG(error && process.code != 0) << "Status: " << style::red_fg << (int)process.code << style::reset;
@@ -69,8 +80,8 @@ std::ostream& operator<<(std::ostream& os, const artifacts_stats& m) {
 
 } // anonymous namespace
 
-Database3::Database3(const std::string& storage)
-  : Database2(storage)
+Database3::Database3(const std::string& storage, OpenMode mode)
+  : Database2(storage, mode)
 {}
 
 void Database3::load_dependencies()
@@ -82,8 +93,20 @@ void Database3::load_dependencies()
     return;
   }
 
+  if (read_only()) {
+    LOG(warning) << "Dependencies table is out of date, not updated in read-only mode";
+    return;
+  }
+
   LOG_CTX() << style::blue_fg << "Extracting dependencies" << style::reset;
 
+  // First extraction, indexes are created once the tables are filled.
+  std::optional<BulkLoad> bulk;
+  if (is_empty("dependencies")) {
+    LOG(debug) << "Bulk loading dependencies";
+    bulk.emplace(*this, std::vector<std::string>{"artifacts", "dependencies"});
+  }
+
   DependenciesExtractor e;
   ProgressBar progress("Dependency extraction");
   e.notifyTotalSteps = [&progress](const size_t size){ progress.start(size); };
@@ -92,6 +115,7 @@ void Database3::load_dependencies()
     ++progress;
   };
   e.run(*this);
+  bulk.reset();
 
   LOG(info) << artifacts_stats(*this);
   LOG(info) << count_dependencies() << " dependencies";
@@ -110,17 +134,37 @@ void Database3::load_symbols()
     return;
   }
 
+  if (read_only()) {
+    LOG(warning) << "Symbols table is out of date, not updated in read-only mode";
+    return;
+  }
+
   LOG_CTX() << style::blue_fg << "Extracting symbols" << style::reset;
 
-  SymbolExtractor e(4);
+  const unsigned int jobs = mJobs > 0 ? mJobs : std::max(std::thread::hardware_concurrency(), 1U);
+  LOG(debug) << "Extracting symbols with " << jobs << " threads";
+
+  std::optional<BulkLoad> bulk;
+  if (is_empty("symbol_references")) {
+    LOG(debug) << "Bulk loading symbols";
+    bulk.emplace(*this, std::vector<std::string>{"symbols", "symbol_references", "archive_members"});
+  }
+
+  SymbolExtractor e(jobs, mSymbolBackend);
   ProgressBar progress("Symbol extraction");
-  e.notifyTotalSteps = [&progress](const size_t size){ progress.start(size); };
+  e.notifyTotalSteps = [&progress](const size_t size, const size_t bytes){ progress.start(size, bytes); };
   e.notifyStep = [&progress](const Artifact& artifact, const SymbolExtractionStatus& status){
     log_symbols(artifact, status);
-    ++progress;
+    progress.advance(status.identity.size > 0 ? static_cast<size_t>(status.identity.size) : 0UL);
   };
-  e.run(*this);
-
+  const SymbolExtractionStats stats = e.run(*this);
+  bulk.reset();
+
+  LOG(info) << stats.extracted << " artifacts extracted, " << stats.refreshed << " refreshed, "
+            << stats.skipped << " unchanged, " << stats.dropped << " dropped";
+  LOG(debug) << stats.batches << " write batches, queue depth " << stats.mean_queue_depth << " avg / " << stats.max_queue_depth << " max, "
+             << "writer stalled " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.writer_stall).count() << " ms, "
+             << "extractors stalled " << std::chrono::duration_cast<std::chrono::milliseconds>(stats.extractor_stall).count() << " ms";
   LOG(info) << count_symbols() << " symbols (" << count_symbol_references() << " references)";
 
   set_timestamp("extract-symbols", std::chrono::high_resolution_clock::now());
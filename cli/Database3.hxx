@@ -2,6 +2,7 @@
 #define DATABASE3_HXX
 
 #include "Database2.hxx"
+#include "database-utils.hxx"
 
 #include <string>
 #include <vector>
@@ -10,8 +11,16 @@ class CompilationCommand;
 
 class Database3 : public Database2
 {
+private:
+  symbol_backend mSymbolBackend = symbol_backend::elf;
+  unsigned int mJobs = 0; // 0: one per hardware thread
+
 public:
-  explicit Database3(const std::string& storage);
+  explicit Database3(const std::string& storage, OpenMode mode = OpenMode::read_write);
+
+  void set_symbol_backend(symbol_backend backend) { mSymbolBackend = backend; }
+
+  void set_jobs(unsigned int jobs) { mJobs = jobs; }
 
   void load_dependencies();
 
@@ -0,0 +1,132 @@
+// Logs a command to $OPLIST (default: /tmp/operations.log), then runs it.
+//
+// Usage: elfxplore-wrap tool [args...]
+//    or: tool-log [args...] (elfxplore-wrap installed under that name)
+//
+// Each record is written with a single write() on a file opened with O_APPEND,
+// records of concurrent invocations (make -j) are not interleaved.
+// The arguments are quoted so that they are split back by shellwords.
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const suffix = "-log";
+
+void append_quoted(std::string& line, const char* arg)
+{
+  if (!line.empty())
+    line += ' ';
+
+  bool plain = *arg != '\0';
+  for(const char* c = arg; *c && plain; ++c)
+    plain = std::isalnum(static_cast<unsigned char>(*c)) || std::strchr("-_./=+,:@%", *c) != nullptr;
+
+  if (plain) {
+    line += arg;
+    return;
+  }
+
+  line += '\'';
+  for(const char* c = arg; *c; ++c) {
+    if (*c == '\'')
+      line += "'\\''";
+    else
+      line += *c;
+  }
+  line += '\'';
+}
+
+void error(const char* what, const char* detail)
+{
+  std::string message = "elfxplore-wrap: ";
+  message += what;
+  message += ": ";
+  message += detail;
+  message += '\n';
+  if (::write(STDERR_FILENO, message.data(), message.size()) < 0) {}
+}
+
+bool log_command(const char* tool, char** args)
+{
+  std::string line;
+
+  char cwd[4096];
+  if (::getcwd(cwd, sizeof(cwd)) == nullptr) {
+    error("getcwd", std::strerror(errno));
+    return false;
+  }
+
+  append_quoted(line, cwd);
+  append_quoted(line, tool);
+  for(char** arg = args; *arg; ++arg)
+    append_quoted(line, *arg);
+  line += '\n';
+
+  const char* oplist = std::getenv("OPLIST");
+  if (oplist == nullptr || *oplist == '\0')
+    oplist = "/tmp/operations.log";
+
+  const int fd = ::open(oplist, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+  if (fd == -1) {
+    error(oplist, std::strerror(errno));
+    return false;
+  }
+
+  // Regular files are not written partially, short of running out of space.
+  ssize_t written;
+  do {
+    written = ::write(fd, line.data(), line.size());
+  } while (written == -1 && errno == EINTR);
+
+  const int write_errno = errno;
+  ::close(fd);
+
+  if (written != static_cast<ssize_t>(line.size())) {
+    error(oplist, written == -1 ? std::strerror(write_errno) : "short write");
+    return false;
+  }
+
+  return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  const char* name = std::strrchr(argv[0], '/');
+  name = name ? name + 1 : argv[0];
+
+  std::string tool;
+  char** args;
+
+  const size_t name_length = std::strlen(name), suffix_length = std::strlen(suffix);
+  if (name_length > suffix_length && std::strcmp(name + name_length - suffix_length, suffix) == 0) {
+    tool.assign(name, name_length - suffix_length);
+    args = argv + 1;
+  } else if (argc > 1) {
+    tool = argv[1];
+    args = argv + 2;
+  } else {
+    error("usage", "elfxplore-wrap tool [args...]");
+    return 2;
+  }
+
+  // Like the build would without the wrapper, the tool runs even if the command could not be logged.
+  log_command(tool.c_str(), args);
+
+  // argv is null-terminated, the tool gets its own name followed by the arguments.
+  args[-1] = const_cast<char*>(tool.c_str());
+  ::execvp(tool.c_str(), args - 1);
+
+  const int exec_errno = errno;
+  error(tool.c_str(), std::strerror(exec_errno));
+  return exec_errno == ENOENT ? 127 : 126;
+}
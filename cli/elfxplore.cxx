@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -15,6 +16,7 @@
 #include "Database3.hxx"
 #include "command-utils.hxx"
 #include "database-utils.hxx"
+#include "process-utils.hxx"
 #include "utils.hxx"
 
 #include "tasks/import-command-task.hxx"
@@ -107,13 +109,54 @@ void validate(boost::any& v,
 
 } // namespace CTXLogger
 
+void validate(boost::any& v,
+              const std::vector<std::string>& values,
+              symbol_backend* /*target_type*/, int)
+{
+  // Make sure no previous assignment to 'v' was made.
+  bpo::validators::check_first_occurrence(v);
+
+  const std::string& s = bpo::validators::get_single_string(values);
+
+  if (s == "elf")
+    v = boost::any(symbol_backend::elf);
+  else if (s == "nm")
+    v = boost::any(symbol_backend::nm);
+  else
+    throw bpo::invalid_option_value(s);
+}
+
+void validate(boost::any& v,
+              const std::vector<std::string>& values,
+              StorageProfile* /*target_type*/, int)
+{
+  // Make sure no previous assignment to 'v' was made.
+  bpo::validators::check_first_occurrence(v);
+
+  const std::string& s = bpo::validators::get_single_string(values);
+
+  if (s == "bulk")
+    v = boost::any(StorageProfile::bulk);
+  else if (s == "query")
+    v = boost::any(StorageProfile::query);
+  else if (s == "lowmem")
+    v = boost::any(StorageProfile::lowmem);
+  else
+    throw bpo::invalid_option_value(s);
+}
+
 int main(int argc, char** argv)
 {
   CTXLogger::ansi_support = ansi::is_atty(std::cerr);
 
   bool help = false;
   bool dryrun = false;
+  bool readonly = false;
+  size_t commit_every = 0;
+  unsigned int commit_interval = 0;
   std::string storage;
+  symbol_backend backend = symbol_backend::elf;
+  StorageProfile profile = StorageProfile::lowmem;
 
   bpo::options_description base_options {"Common options"};
   base_options.add_options()
@@ -126,9 +169,25 @@ int main(int argc, char** argv)
       ("dry-run,n",
        bpo::bool_switch(&dryrun),
        "Do not write anything to the database.")
+      ("commit-every",
+       bpo::value<size_t>(&commit_every)->value_name("N")->default_value(0, "never"),
+       "Commit the extractions every N artifacts or commands. An interrupted extraction resumes from the last commit.")
+      ("commit-interval",
+       bpo::value<unsigned int>(&commit_interval)->value_name("seconds")->default_value(0, "never"),
+       "Commit the extractions at this interval. An interrupted extraction resumes from the last commit.")
+      ("read-only",
+       bpo::bool_switch(&readonly),
+       "Open the database read-only, with shared locking: several read-only commands can query it at the same time.")
       ("storage",
        bpo::value<std::string>(&storage)->value_name("file")->default_value(envvar("ELFXPLORE_STORAGE", ":memory:")),
        "SQLite database used as backend. If not specified, a temporary in-memory database is used.")
+      ("symbol-backend",
+       bpo::value<symbol_backend>(&backend)->default_value(symbol_backend::elf, "elf"),
+       "Symbol extraction backend: elf (built-in ELF reader, default) or nm (spawn nm processes).")
+      ("db-profile",
+       bpo::value<StorageProfile>(&profile)->value_name("profile"),
+       "SQLite cache and temporary storage settings: bulk (large page cache, default for import-command and extract), "
+       "query (database mapped in memory, default for analyse and dependencies) or lowmem (SQLite defaults, default otherwise).")
       ;
 
   if (argc == 1) {
@@ -173,7 +232,13 @@ int main(int argc, char** argv)
 
     task->parse_args(args);
 
-    Database3 db(storage);
+    Database3 db(storage, readonly ? OpenMode::read_only : OpenMode::read_write);
+    db.set_symbol_backend(backend);
+    db.set_storage_profile(vm.count("db-profile") ? profile : task->storage_profile());
+
+    // A dry run rolls back everything, nothing is committed on the way.
+    if (!dryrun && !readonly)
+      db.set_checkpoint_interval(commit_every, std::chrono::seconds(commit_interval));
 
     SQLite::Transaction transaction(db.database());
     bool commit = !dryrun;
@@ -185,7 +250,29 @@ int main(int argc, char** argv)
     catch (const std::exception& ex) { LOG_EX(fatal, ex); }
     catch (...) { LOG(fatal) << "Unknown exception"; }
 
-    if (dryrun) {
+    const SpawnStats spawns = spawn_stats();
+    if (spawns.count > 0)
+      LOG(debug) << spawns.count << " processes spawned, latency "
+                << std::chrono::duration_cast<std::chrono::microseconds>(spawns.total).count() / spawns.count << " us avg / "
+                << std::chrono::duration_cast<std::chrono::microseconds>(spawns.max).count() << " us max";
+
+    const PathCacheStats paths = path_cache_stats();
+    if (paths.misses > 0)
+      LOG(debug) << paths.misses << " paths resolved in " << paths.directories << " directories, "
+                << paths.hits << " found in the cache";
+
+    const StatementCacheStats& statements = db.statement_cache_stats();
+    if (statements.misses > 0)
+      LOG(debug) << statements.misses << " statements prepared in "
+                << std::chrono::duration_cast<std::chrono::microseconds>(statements.prepare).count() << " us, "
+                << statements.hits << " reused from the cache";
+
+    if (db.checkpoints() > 0)
+      LOG(debug) << db.checkpoints() << " intermediate commits";
+
+    if (readonly) {
+      // Nothing was written, the transaction is rolled back.
+    } else if (dryrun) {
       LOG(info) << "Dry-run, aborting transaction";
     } else {
       if (commit) {
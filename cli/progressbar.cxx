@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <unistd.h>
 
 #include "logger.hxx"
@@ -12,27 +13,36 @@ ProgressBar::ProgressBar(std::string message)
   : mMessage(std::move(message))
   , mExpectedCount(0UL)
   , mCount(0UL)
+  , mExpectedBytes(0UL)
+  , mBytes(0UL)
   , mEnabled(::isatty(fileno(stderr)))
 {
   if (mEnabled)
     LOG_FLUSH();
 }
 
-void ProgressBar::start(const size_t expected_count) {
+void ProgressBar::start(const size_t expected_count, const size_t expected_bytes) {
   if (!mEnabled)
     return;
 
   mExpectedCount = expected_count;
+  mExpectedBytes = expected_bytes;
   mStart = std::chrono::high_resolution_clock::now();
   mNextUpdate = mStart + 15ms;
 }
 
 void ProgressBar::operator++()
+{
+  advance(0UL);
+}
+
+void ProgressBar::advance(const size_t bytes)
 {
   if (!mEnabled)
     return;
 
   ++mCount;
+  mBytes += bytes;
 
   const auto now = std::chrono::high_resolution_clock::now();
   const bool last = mCount == mExpectedCount;
@@ -41,10 +51,22 @@ void ProgressBar::operator++()
     mNextUpdate = now + 15ms;
 
     const double elapsed = std::chrono::duration<double>(now - mStart).count();
-    const double eta = mExpectedCount * elapsed / mCount - elapsed;
-    std::cerr << mMessage << ' ' << mCount << "/" << mExpectedCount
-              << " Elapsed: " << std::setw(4) << std::right << (int)elapsed << " s / "
-              << "ETA: " << std::setw(4) << std::right << (int)eta << " s\r" << std::flush;
+
+    // Steps may have very different sizes, the ETA is based on bytes when they are known.
+    const double eta = mExpectedBytes > 0 && mBytes > 0
+        ? mExpectedBytes * elapsed / mBytes - elapsed
+        : mExpectedCount * elapsed / mCount - elapsed;
+
+    // Formatted apart, the flags of std::cerr are left untouched.
+    std::ostringstream line;
+    line << mMessage << ' ' << mCount << "/" << mExpectedCount;
+    if (mExpectedBytes > 0)
+      line << ' ' << std::setw(7) << std::right << std::fixed << std::setprecision(1)
+           << (elapsed > 0 ? mBytes / elapsed / (1024 * 1024) : 0.0) << " MB/s";
+    line << " Elapsed: " << std::setw(4) << std::right << (int)elapsed << " s / "
+         << "ETA: " << std::setw(4) << std::right << (int)eta << " s\r";
+
+    std::cerr << line.str() << std::flush;
     if (last)
       std::cerr << std::endl;
   }
@@ -9,15 +9,19 @@ class ProgressBar
 private:
   std::string mMessage;
   size_t mExpectedCount, mCount;
+  size_t mExpectedBytes, mBytes;
   std::chrono::system_clock::time_point mStart, mNextUpdate;
   bool mEnabled;
 
 public:
   ProgressBar(std::string message);
 
-  void start(const size_t expected_count);
+  void start(const size_t expected_count, const size_t expected_bytes = 0UL);
 
   void operator++();
+
+  // One more step, which processed that many bytes.
+  void advance(const size_t bytes);
 };
 
 #endif // PROGRESSBAR_HXX
@@ -1,3 +1,10 @@
 #include "task.hxx"
 
+#include "Database2.hxx"
+
 Task::Task() = default;
+
+StorageProfile Task::storage_profile() const
+{
+  return StorageProfile::lowmem;
+}
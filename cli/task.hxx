@@ -9,6 +9,7 @@
 #include <boost/program_options/options_description.hpp>
 
 class Database3;
+enum class StorageProfile;
 
 class Task
 {
@@ -24,6 +25,9 @@ public:
   virtual void parse_args(const std::vector<std::string>& args) = 0;
 
   virtual void execute(Database3& db) = 0;
+
+  // Storage profile used unless --db-profile is given.
+  virtual StorageProfile storage_profile() const;
 };
 
 #endif // COMMAND_HXX
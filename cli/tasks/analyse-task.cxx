@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <chrono>
@@ -9,14 +10,12 @@
 #include <map>
 #include <filesystem>
 
-#include <boost/process.hpp>
-#include <boost/asio.hpp>
-
 #include "ansi.hxx"
 
 #include "infix_iterator.hxx"
 
 #include "Database3.hxx"
+#include "connection-pool.hxx"
 #include "query-utils.hxx"
 #include "utils.hxx"
 #include "command-utils.hxx"
@@ -24,13 +23,13 @@
 #include "progressbar.hxx"
 #include "csvprinter.h"
 #include "process-utils.hxx"
+#include "process-reactor.hxx"
 #include "utils.hxx"
 
 #include "linemarkers/linemarkers.hxx"
 
 namespace bpo = boost::program_options;
 namespace fs = std::filesystem;
-namespace bp = boost::process;
 using ansi::style;
 
 namespace {
@@ -118,7 +117,7 @@ void analyse_duplicated_symbols(Database2& db,
 {
   std::vector<std::string> conditions;
 
-  auto build_condition = [&conditions] (const char* expr, const std::vector<std::string>& values) {
+  auto build_condition = [&conditions] (const char* expr, const auto& values) {
     if (!values.empty()) {
       std::stringstream ss;
       ss << expr << " " << in_expr(values);
@@ -126,14 +125,21 @@ void analyse_duplicated_symbols(Database2& db,
     }
   };
 
+  auto category_codes = [] (const std::vector<std::string>& names) {
+    std::vector<int> codes;
+    for(const std::string& name : names)
+      codes.push_back(symbol_category(name));
+    return codes;
+  };
+
   build_condition("artifacts.type in", included_types);
   build_condition("artifacts.type not in", excluded_types);
-  build_condition("symbol_references.category in", included_categories);
-  build_condition("symbol_references.category not in", excluded_categories);
+  build_condition("symbol_references.category in", category_codes(included_categories));
+  build_condition("symbol_references.category not in", category_codes(excluded_categories));
 
   std::stringstream duplicated_symbols_query;
   duplicated_symbols_query << R"(
-select symbols.id, symbols.name as name, symbols.dname as dname, count(symbol_references.id) as occurences, sum(symbol_references.size) as total_size
+select symbols.id, symbols.name as name, symbols.dname as dname, count(*) as occurences, sum(symbol_references.size) as total_size
 from symbols
 inner join symbol_references on symbols.id = symbol_references.symbol_id
 inner join artifacts on artifacts.id = symbol_references.artifact_id
@@ -180,12 +186,13 @@ std::set<long long> find_unresolved_symbols(Database2& db, const long long artif
 select symbol_id
 from symbol_references
 inner join dependencies on symbol_references.artifact_id = dependencies.dependency_id
-where symbol_references.category = "external"
+where symbol_references.category = )" << external_symbol << R"(
 and dependencies.dependee_id = ?
-and symbol_references.symbol_id in )" << in_expr(undefined_symbols);
+and symbol_references.symbol_id in (select value from json_each(?)))";
 
-  SQLite::Statement stm = db.statement(ss.str());
+  SQLite::Statement& stm = db.cached_statement(ss.str());
   stm.bind(1, artifact_id);
+  Database2::bind_ids(stm, 2, undefined_symbols);
 
   while(stm.executeStep()) {
     unresolved_symbols.erase(stm.getColumn(0).getInt64());
@@ -200,26 +207,63 @@ std::vector<T> as_vector(const std::set<T>& s)
   return std::vector<T>(s.cbegin(), s.cend());
 }
 
-void analyse_undefined_symbols(Database2& db, const std::vector<long long>& artifacts)
+// Runs f(db, i) for i in [0, size) from num_threads threads, with a connection of the pool.
+// The first exception thrown is rethrown once all the threads are done.
+void parallel_for(ConnectionPool& pool, const size_t size, const unsigned int num_threads,
+                  const std::function<void(Database2&, size_t)>& f)
 {
-  for(const long long artifact_id : artifacts) {
-    const std::vector<long long> undefined_symbols = as_vector(find_unresolved_symbols(db, artifact_id));
+  std::exception_ptr error;
+
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+  for(size_t i = 0; i < size; ++i) {
+    try {
+      ConnectionPool::Lease db = pool.acquire();
+      f(*db, i);
+    } catch (...) {
+#pragma omp critical
+      if (!error) error = std::current_exception();
+    }
+  }
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+void analyse_undefined_symbols(Database2& db, ConnectionPool& pool, const std::vector<long long>& artifacts, const unsigned int num_threads)
+{
+  struct UnresolvedSymbols {
+    std::map<long long, std::string> names;
+    std::map<long long, std::vector<std::string>> resolving_artifacts;
+  };
+
+  std::vector<UnresolvedSymbols> unresolved(artifacts.size());
+
+  parallel_for(pool, artifacts.size(), num_threads, [&artifacts, &unresolved](Database2& db, const size_t i){
+    const std::vector<long long> undefined_symbols = as_vector(find_unresolved_symbols(db, artifacts[i]));
 
     if (!undefined_symbols.empty()) {
-      const std::map<long long, std::vector<std::string>> resolving_artifacts = db.resolve_symbols(undefined_symbols);
+      unresolved[i].resolving_artifacts = db.resolve_symbols(undefined_symbols);
+      unresolved[i].names = get_symbol_hnames(db, undefined_symbols);
+    }
+  });
 
-      std::cout << db.artifact_name_by_id(artifact_id) << "\n";
+  for(size_t i = 0; i < artifacts.size(); ++i) {
+    if (unresolved[i].names.empty())
+      continue;
 
-      for(const std::pair<long long, std::string>& undefined_symbol : get_symbol_hnames(db, undefined_symbols)) {
-        std::cout << "\t" << undefined_symbol.second;
+    const std::map<long long, std::vector<std::string>>& resolving_artifacts = unresolved[i].resolving_artifacts;
 
-        auto where_resolved = resolving_artifacts.find(undefined_symbol.first);
-        if (where_resolved != resolving_artifacts.cend()) {
-          std::cout << " -> ";
-          std::copy(where_resolved->second.cbegin(), where_resolved->second.cend(), infix_ostream_iterator<std::string>(std::cout, ", "));
-        }
-        std::cout << "\n";
+    std::cout << db.artifact_name_by_id(artifacts[i]) << "\n";
+
+    for(const std::pair<const long long, std::string>& undefined_symbol : unresolved[i].names) {
+      std::cout << "\t" << undefined_symbol.second;
+
+      auto where_resolved = resolving_artifacts.find(undefined_symbol.first);
+      if (where_resolved != resolving_artifacts.cend()) {
+        std::cout << " -> ";
+        std::copy(where_resolved->second.cbegin(), where_resolved->second.cend(), infix_ostream_iterator<std::string>(std::cout, ", "));
       }
+      std::cout << "\n";
     }
   }
 }
@@ -235,10 +279,11 @@ from artifacts
 inner join dependencies on dependencies.dependency_id = artifacts.id
 where artifacts.type = "shared"
 and dependencies.dependee_id = ?
-and dependencies.dependency_id not in )" << in_expr(useful_dependencies);
+and dependencies.dependency_id not in (select value from json_each(?)))";
 
-  SQLite::Statement useless_dependencies_stm = db.statement(useless_dependencies_q.str());
+  SQLite::Statement& useless_dependencies_stm = db.cached_statement(useless_dependencies_q.str());
   useless_dependencies_stm.bind(1, dependee_id);
+  Database2::bind_ids(useless_dependencies_stm, 2, useful_dependencies);
 
   std::vector<std::string> useless_dependencies;
 
@@ -251,38 +296,45 @@ and dependencies.dependency_id not in )" << in_expr(useful_dependencies);
 
 std::vector<long long> get_shared_dependencies(Database2& db, const long long dependee_id)
 {
-  SQLite::Statement dependencies_stm = db.build_get_depend_stm("dependency_id", "dependee_id", {"shared"}, {});
+  SQLite::Statement& dependencies_stm = db.build_get_depend_stm("dependency_id", "dependee_id", {"shared"}, {});
   dependencies_stm.bind(1, dependee_id);
   return Database2::get_ids(dependencies_stm);
 }
 
 std::vector<long long> get_useful_dependencies_simple1(Database2& db, const long long dependee_id)
 {
+  // Scanning the exports of the few dependencies beats one lookup per undefined symbol, the unary +
+  // keeps SQLite from using the symbol_id column of the primary key.
   std::stringstream useful_dependencies_q;
   useful_dependencies_q << R"(
 select distinct symbol_references.artifact_id
 from symbol_references
-where symbol_references.artifact_id in)" << in_expr(get_shared_dependencies(db, dependee_id)) << R"(
-and symbol_references.category = "external"
-and symbol_references.symbol_id in )" << in_expr(db.undefined_symbols(dependee_id));
+where symbol_references.artifact_id in (select value from json_each(?))
+and symbol_references.category = )" << external_symbol << R"(
+and +symbol_references.symbol_id in (select value from json_each(?)))";
 
-  SQLite::Statement useful_dependencies_stm = db.statement(useful_dependencies_q.str());
+  SQLite::Statement& useful_dependencies_stm = db.cached_statement(useful_dependencies_q.str());
+  Database2::bind_ids(useful_dependencies_stm, 1, get_shared_dependencies(db, dependee_id));
+  Database2::bind_ids(useful_dependencies_stm, 2, db.undefined_symbols(dependee_id));
   return Database2::get_ids(useful_dependencies_stm);
 }
 
 std::map<long long, std::vector<long long>> detail_useful_dependencies(Database2& db, const long long dependee_id)
 {
+  // Same plan as get_useful_dependencies_simple1().
   std::stringstream useful_dependencies_q;
   useful_dependencies_q << R"(
 select symbol_references.artifact_id, symbol_references.symbol_id
 from symbol_references
-where symbol_references.artifact_id in)" << in_expr(get_shared_dependencies(db, dependee_id)) << R"(
-and symbol_references.category = "external"
-and symbol_references.symbol_id in )" << in_expr(db.undefined_symbols(dependee_id));
+where symbol_references.artifact_id in (select value from json_each(?))
+and symbol_references.category = )" << external_symbol << R"(
+and +symbol_references.symbol_id in (select value from json_each(?)))";
 
   std::map<long long, std::vector<long long>> resolved_symbols;
 
-  SQLite::Statement stm = db.statement(useful_dependencies_q.str());
+  SQLite::Statement& stm = db.cached_statement(useful_dependencies_q.str());
+  Database2::bind_ids(stm, 1, get_shared_dependencies(db, dependee_id));
+  Database2::bind_ids(stm, 2, db.undefined_symbols(dependee_id));
   while (stm.executeStep()) {
     resolved_symbols[stm.getColumn(0).getInt64()].push_back(stm.getColumn(1).getInt64());
   }
@@ -302,7 +354,7 @@ and symbol_references.symbol_id in )" << in_expr(db.undefined_symbols(dependee_i
 //inner join artifacts on artifacts.id = symbol_references.artifact_id
 //where dependencies.dependee_id = ?
 //and artifacts.type = "shared"
-//and symbol_references.category = "external"
+//and symbol_references.category = )" << external_symbol << R"(
 //and symbol_references.symbol_id in )" << in_expr(undefined_symbols);
 
 //  SQLite::Statement useful_dependencies_stm = db.statement(useful_dependencies_q.str());
@@ -391,10 +443,17 @@ where generating_command_id is not NULL
   return artifacts;
 }
 
-void analyse_useless_dependencies_symbols(Database2& db, const std::vector<long long>& artifacts)
+void analyse_useless_dependencies_symbols(Database2& db, ConnectionPool& pool, const std::vector<long long>& artifacts, const unsigned int num_threads)
 {
-  for(const long long artifact_id : artifacts) {
-    const std::vector<std::string> useless_dependencies = get_useless_dependencies(db, artifact_id);
+  std::vector<std::vector<std::string>> useless(artifacts.size());
+
+  parallel_for(pool, artifacts.size(), num_threads, [&artifacts, &useless](Database2& db, const size_t i){
+    useless[i] = get_useless_dependencies(db, artifacts[i]);
+  });
+
+  for(size_t i = 0; i < artifacts.size(); ++i) {
+    const long long artifact_id = artifacts[i];
+    const std::vector<std::string>& useless_dependencies = useless[i];
 
     LOG(debug || !useless_dependencies.empty())
         << style::green_fg << "Artifact " << artifact_id << style::reset << " " << db.artifact_name_by_id(artifact_id);
@@ -444,22 +503,15 @@ void analyse_useless_dependencies_ldd(Database2& db, const std::vector<long long
 {
   for(const long long artifact_id : artifacts) {
     const std::string artifact = db.artifact_name_by_id(artifact_id);
-    boost::asio::io_service ios;
+    Process c(std::vector<std::string>{ldd(), "-u", "-r", artifact});
 
-    std::future<std::string> out_, err_;
-
-    bp::child c(ldd(), "-u", "-r", artifact,
-                bp::std_in.close(),
-                bp::std_out > out_,
-                bp::std_err > err_,
-                ios);
-
-    ios.run();
+    std::string out_, err_;
+    c.communicate(&out_, &err_);
 
     std::vector<std::string> useless_dependencies;
 
-    if (c.exit_code() != 0) {
-      std::stringstream ss(out_.get());
+    if (c.wait() != 0) {
+      std::stringstream ss(out_);
       std::string line;
       if (ss) std::getline(ss, line); // Skip first line
 
@@ -470,7 +522,7 @@ void analyse_useless_dependencies_ldd(Database2& db, const std::vector<long long
 
     std::sort(useless_dependencies.begin(), useless_dependencies.end());
 
-    const std::string err = trim_copy(err_.get());
+    const std::string err = trim_copy(err_);
 
     LOG(always && (!useless_dependencies.empty() || !err.empty())) << style::green_fg << "Artifact #" << artifact_id << style::reset << " " << artifact;
 
@@ -500,7 +552,7 @@ std::vector<CompilationCommand> get_object_commands(Database2& db)
   std::vector<CompilationCommand> commands;
 
   const char* q = R"(
-select commands.id, commands.directory, commands.executable, commands.args, artifacts.name
+select commands.id, commands.directory, commands.executable, commands.args, commands.argv, artifacts.name
 from commands
 inner join artifacts
 on artifacts.generating_command_id = commands.id
@@ -515,7 +567,8 @@ where artifacts.type = "object"
     cmd.directory  = stm.getColumn(1).getString();
     cmd.executable = stm.getColumn(2).getString();
     cmd.args       = stm.getColumn(3).getString();
-    cmd.output     = stm.getColumn(4).getString();
+    cmd.argv       = stm.getColumn(4).getString();
+    cmd.output     = stm.getColumn(5).getString();
 
     commands.emplace_back(std::move(cmd));
   }
@@ -528,7 +581,7 @@ std::vector<CompilationCommand> get_link_commands(Database2& db)
   std::vector<CompilationCommand> commands;
 
   const char* q = R"(
-select commands.id, commands.directory, commands.executable, commands.args, artifacts.name
+select commands.id, commands.directory, commands.executable, commands.args, commands.argv, artifacts.name
 from commands
 inner join artifacts
 on artifacts.generating_command_id = commands.id
@@ -543,7 +596,8 @@ where artifacts.type in ("static", "shared", "executable")
     cmd.directory  = stm.getColumn(1).getString();
     cmd.executable = stm.getColumn(2).getString();
     cmd.args       = stm.getColumn(3).getString();
-    cmd.output     = stm.getColumn(4).getString();
+    cmd.argv       = stm.getColumn(4).getString();
+    cmd.output     = stm.getColumn(5).getString();
 
     commands.emplace_back(std::move(cmd));
   }
@@ -551,81 +605,64 @@ where artifacts.type in ("static", "shared", "executable")
   return commands;
 }
 
-ProcessResult time_command(const std::string& cmd, const std::string& directory, double& duration) {
+ProcessResult time_command(ProcessReactor& reactor, std::vector<std::string> argv, const std::string& directory, double& duration) {
   ProcessResult res;
-  res.command = cmd;
-
-  boost::asio::io_service ios;
-  std::future<std::string> err_;
+  res.command = shell_join(argv);
 
   const auto start = std::chrono::high_resolution_clock::now();
 
-  bp::child p(cmd,
-              bp::start_dir = directory,
-              bp::std_in.close(),
-              bp::std_out > bp::null,
-              bp::std_err > err_,
-              ios);
-
-  ios.run();
-  p.wait();
+  std::future<int> code = reactor.spawn(std::move(argv), directory, nullptr,
+                                        [&res](std::string_view buffer){ res.err.append(buffer); });
+  res.code = code.get();
 
   const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
   duration = elapsed.count();
 
-  res.code = p.exit_code();
-  res.err = err_.get();
-
   return res;
 }
 
-ProcessResult wc_preprocessor(const CompilationCommand& command, size_t& c, size_t& l) {
-  ProcessResult res;
-  res.command = redirect_gcc_output(command) + " -E";
-
-  bp::ipstream out_stream, err_stream;
+ProcessResult wc_preprocessor(ProcessReactor& reactor, const CompilationCommand& command, size_t& c, size_t& l) {
+  std::vector<std::string> argv = redirect_gcc_output(command);
+  argv.emplace_back("-E");
 
-  bp::child p(res.command,
-              bp::start_dir = command.directory,
-              bp::std_in.close(),
-              bp::std_out > out_stream,
-              bp::std_err > err_stream
-              );
+  ProcessResult res;
+  res.command = shell_join(argv);
 
-  std::thread out_thread([&out_stream, &c, &l](){ wc(out_stream, c, l); });
-  std::future<std::string> err_f = std::async(std::launch::async, [&err_stream](){
-    std::ostringstream ss;
-    ss << err_stream.rdbuf();
-    return ss.str();
-  });
-  out_thread.join();
+  // Same counts as wc(): characters without line feeds, an unterminated last line counts as a line.
+  bool unterminated = false;
 
-  p.wait();
+  std::future<int> code = reactor.spawn(std::move(argv), command.directory,
+                                        [&c, &l, &unterminated](std::string_view buffer){
+    const size_t lines = std::count(buffer.begin(), buffer.end(), '\n');
+    c += buffer.size() - lines;
+    l += lines;
+    unterminated = buffer.back() != '\n';
+  },
+                                        [&res](std::string_view buffer){ res.err.append(buffer); });
+  res.code = code.get();
 
-  res.code = p.exit_code();
-  res.err = err_f.get();
+  if (unterminated)
+    ++l;
 
   return res;
 }
 
-ProcessResult time_preprocessor(const CompilationCommand& command, double& duration) {
-  const std::string cmd = redirect_gcc_output(command, "/dev/null") + " -E";
-  return time_command(cmd, command.directory, duration);
+ProcessResult time_preprocessor(ProcessReactor& reactor, const CompilationCommand& command, double& duration) {
+  std::vector<std::string> argv = redirect_gcc_output(command, "/dev/null");
+  argv.emplace_back("-E");
+  return time_command(reactor, std::move(argv), command.directory, duration);
 }
 
-ProcessResult time_compile(const CompilationCommand& command, double& duration) {
-  const std::string cmd = redirect_gcc_output(command, "/dev/null");
-  return time_command(cmd, command.directory, duration);
+ProcessResult time_compile(ProcessReactor& reactor, const CompilationCommand& command, double& duration) {
+  return time_command(reactor, redirect_gcc_output(command, "/dev/null"), command.directory, duration);
 }
 
-ProcessResult time_link(const CompilationCommand& command, double& duration) {
+ProcessResult time_link(ProcessReactor& reactor, const CompilationCommand& command, double& duration) {
   if (is_cc(command.executable)) {
-    const std::string cmd = redirect_gcc_output(command, "/dev/null");
-    return time_command(cmd, command.directory, duration);
+    return time_command(reactor, redirect_gcc_output(command, "/dev/null"), command.directory, duration);
   } else {
     const FileSystemGuard a = FileSystemGuard(fs::temp_directory_path() / (random_alnum(16) + ".a"));
-    const std::string cmd = redirect_ar_output(command, a.path().string());
-    return time_command(cmd, command.directory, duration);
+    return time_command(reactor, redirect_ar_output(command, a.path().string()), command.directory, duration);
   }
 }
 
@@ -660,13 +697,16 @@ void log_command_error(const std::string& directory, const ProcessResult& res) {
   LOG(error) << res.err;
 }
 
-void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& modes, const unsigned int num_threads, std::ostream& out) {
+void analyse_commands(Database2& db, ConnectionPool& pool, const std::vector<command_analysis_mode>& modes, const unsigned int num_threads, std::ostream& out) {
   const bool analyse_source = std::find(modes.begin(), modes.end(), command_analysis_mode::source_count) != modes.end();
   const bool analyse_preprocessor_count = std::find(modes.begin(), modes.end(), command_analysis_mode::preprocessor_count) != modes.end();
   const bool analyse_preprocessor_time = std::find(modes.begin(), modes.end(), command_analysis_mode::preprocessor_time) != modes.end();
   const bool analyse_compile_time = std::find(modes.begin(), modes.end(), command_analysis_mode::compile_time) != modes.end();
   const bool analyse_link_time = std::find(modes.begin(), modes.end(), command_analysis_mode::link_time) != modes.end();
 
+  // Commands run from the OpenMP threads, at most one child per thread.
+  ProcessReactor reactor(num_threads);
+
   std::vector<std::string> columns;
   if (analyse_source)
     columns.insert(columns.end(), {"source-chars", "source-lines"});
@@ -701,8 +741,7 @@ void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& m
       MeasuresMap measures;
       std::vector<std::string> inputs;
 
-#pragma omp critical
-      inputs = db.get_sources(command.id);
+      inputs = pool.acquire()->get_sources(command.id);
 
       if (analyse_source) {
         for(const std::string& source : inputs) {
@@ -713,7 +752,7 @@ void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& m
       }
 
       if (analyse_preprocessor_count) {
-        const ProcessResult res = wc_preprocessor(command, preprocessor_chars.value, preprocessor_lines.value);
+        const ProcessResult res = wc_preprocessor(reactor, command, preprocessor_chars.value, preprocessor_lines.value);
         measures.emplace("preprocessor-chars", preprocessor_chars);
         measures.emplace("preprocessor-lines", preprocessor_lines);
         if (res.code != 0) {
@@ -723,7 +762,7 @@ void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& m
       }
 
       if (analyse_preprocessor_time) {
-        const ProcessResult res = time_preprocessor(command, preprocessor_time.value);
+        const ProcessResult res = time_preprocessor(reactor, command, preprocessor_time.value);
         measures.emplace("preprocessor-time", preprocessor_time);
         if (res.code != 0) {
 #pragma omp critical
@@ -732,7 +771,7 @@ void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& m
       }
 
       if (analyse_compile_time) {
-        const ProcessResult res = time_compile(command, compile_time.value);
+        const ProcessResult res = time_compile(reactor, command, compile_time.value);
         measures.emplace("command-time", compile_time);
         if (res.code != 0) {
 #pragma omp critical
@@ -764,18 +803,22 @@ void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& m
       std::vector<std::string> inputs;
 
       Measure<double> link_time;
-      const ProcessResult res = time_link(command, link_time.value);
+      const ProcessResult res = time_link(reactor, command, link_time.value);
       measures.emplace("command-time", link_time);
 
+      {
+        ConnectionPool::Lease db = pool.acquire();
+        const long long artifact_id = db->artifact_id_by_command(command.id);
+        for(const long long dependency_id : db->dependencies(artifact_id)) {
+          inputs.emplace_back(db->artifact_name_by_id(dependency_id));
+        }
+      }
+
 #pragma omp critical
       {
         if (res.code != 0)
           log_command_error(command.directory, res);
 
-        const long long artifact_id = db.artifact_id_by_command(command.id);
-        for(const long long dependency_id : db.dependencies(artifact_id)) {
-          inputs.emplace_back(db.artifact_name_by_id(dependency_id));
-        }
         print(csv, command, inputs, measures, columns);
         ++progress;
       }
@@ -783,36 +826,18 @@ void analyse_commands(Database2& db, const std::vector<command_analysis_mode>& m
   }
 }
 
-ProcessResult list_includes(const CompilationCommand& command,
+ProcessResult list_includes(ProcessReactor& reactor,
+                            const CompilationCommand& command,
                             IncludeTree& include_tree) {
-  ProcessResult res;
-  res.command = redirect_gcc_output(command) + " -E";
-
-  bp::ipstream out_stream, err_stream;
+  std::vector<std::string> argv = redirect_gcc_output(command);
+  argv.emplace_back("-E");
 
-  bp::child p(res.command,
-              bp::start_dir = command.directory,
-              bp::std_in.close(),
-              bp::std_out > out_stream,
-              bp::std_err > err_stream
-              );
-
-  std::future<IncludeTree> include_tree_f = std::async(std::launch::async, [&out_stream](){
-    return IncludeTree::from_stream(out_stream, false);
-  });
-
-  std::future<std::string> err_f = std::async(std::launch::async, [&err_stream](){
-    std::ostringstream ss;
-    ss << err_stream.rdbuf();
-    return ss.str();
-  });
+  std::future<ProcessResult> process = reactor.run(std::move(argv), command.directory);
+  ProcessResult res = process.get();
 
-  p.wait();
-
-  include_tree = include_tree_f.get();
-
-  res.code = p.exit_code();
-  res.err = err_f.get();
+  std::istringstream out_stream(res.out);
+  res.out.clear();
+  include_tree = IncludeTree::from_stream(out_stream, false);
 
   return res;
 }
@@ -825,11 +850,13 @@ void analyse_includes(Database2& db, const unsigned int num_threads) {
   ProgressBar progress("Include files analysis");
   progress.start(commands.size());
 
+  ProcessReactor reactor(num_threads);
+
 #pragma omp parallel for num_threads(num_threads) schedule(guided)
   for(size_t i = 0; i < commands.size(); ++i) {
 
     IncludeTree include_tree;
-    auto res = list_includes(commands[i], include_tree);
+    auto res = list_includes(reactor, commands[i], include_tree);
 
 #pragma omp critical
     {
@@ -867,10 +894,10 @@ boost::program_options::options_description Analyse_Task::options()
        "Only consider artifacts not matching those types.")
       ("category",
        bpo::value<std::vector<std::string>>()->multitoken()->default_value({}, ""),
-       "Only consider references matching those categories.")
+       "Only consider references matching those categories (undefined, external, internal).")
       ("not-category",
        bpo::value<std::vector<std::string>>()->multitoken()->default_value({}, ""),
-       "Only consider references not matching those categories.")
+       "Only consider references not matching those categories (undefined, external, internal).")
       ("artifact",
        bpo::value<std::vector<std::string>>()->multitoken()->default_value({}, ""),
        "Artifact to export.")
@@ -908,6 +935,11 @@ void Analyse_Task::parse_args(const std::vector<std::string>& args)
   }
 }
 
+StorageProfile Analyse_Task::storage_profile() const
+{
+  return StorageProfile::query;
+}
+
 void Analyse_Task::execute(Database3& db)
 {
   if (vm.count("duplicated-symbols")) {
@@ -922,7 +954,8 @@ void Analyse_Task::execute(Database3& db)
     db.load_symbols();
 
     const std::vector<long long> artifacts = get_generated_shared_libs_and_executables(db, vm["artifact"].as<std::vector<std::string>>());
-    analyse_undefined_symbols(db, artifacts);
+    ConnectionPool pool(db);
+    analyse_undefined_symbols(db, pool, artifacts, mNumThreads);
   } else if (vm.count("useless-dependencies")) {
     db.load_dependencies();
 
@@ -930,7 +963,8 @@ void Analyse_Task::execute(Database3& db)
     const std::vector<long long> artifacts = get_generated_shared_libs_and_executables(db, vm["artifact"].as<std::vector<std::string>>());
 
     if (mode == useless_dependencies_analysis_modes::symbols) {
-      analyse_useless_dependencies_symbols(db, artifacts);
+      ConnectionPool pool(db);
+      analyse_useless_dependencies_symbols(db, pool, artifacts, mNumThreads);
     } else if (mode == useless_dependencies_analysis_modes::ldd) {
       analyse_useless_dependencies_ldd(db, artifacts);
     }
@@ -943,7 +977,8 @@ void Analyse_Task::execute(Database3& db)
     ss << fs::current_path().string() << "/" << std::put_time(std::localtime(&now), "elfxplore-commands-%Y-%m-%d-%H-%M-%S.csv");
 
     std::ofstream out(ss.str());
-    analyse_commands(db, modes, mNumThreads, out);
+    ConnectionPool pool(db);
+    analyse_commands(db, pool, modes, mNumThreads, out);
     out.close();
   } else if (vm.count("includes")) {
     analyse_includes(db, mNumThreads);
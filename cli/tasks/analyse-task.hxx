@@ -15,6 +15,7 @@ public:
   boost::program_options::options_description options() override;
   void parse_args(const std::vector<std::string>& args) override;
   void execute(Database3& db) override;
+  StorageProfile storage_profile() const override;
 };
 
 #endif // ANALYSESYMBOLSTASK_HXX
@@ -3,6 +3,8 @@
 #include <iostream>
 
 #include "Database3.hxx"
+#include "archive.hxx"
+#include "logger.hxx"
 #include "query-utils.hxx"
 
 namespace bpo = boost::program_options;
@@ -17,6 +19,9 @@ boost::program_options::options_description Artifacts_Task::options()
       ("not-type",
        bpo::value<std::vector<std::string>>()->multitoken()->default_value({}, ""),
        "Only consider artifacts not matching those types.")
+      ("defining",
+       bpo::value<std::string>()->value_name("symbol"),
+       "List the static libraries defining that symbol, with the defining member, using the archive symbol index.")
       ;
 
   return opt;
@@ -52,8 +57,33 @@ void Artifacts_Task::execute(Database3& db)
   ss << " order by type asc, name asc";
 
   auto stm = db.statement(ss.str());
-  while (stm.executeStep()) {
-    std::cout << stm.getColumn(0).getString() << " : " << stm.getColumn(1).getString() << "\n";
+
+  if (vm.count("defining")) {
+    const std::string& symbol = vm["defining"].as<std::string>();
+
+    // The archive index is read, not the members: the artifacts need not have been extracted.
+    while (stm.executeStep()) {
+      const std::string name = stm.getColumn(0).getString();
+      if (stm.getColumn(1).getString() != "static")
+        continue;
+
+      try {
+        const Archive archive(name);
+        if (!archive.has_index()) {
+          LOG(warning) << name << " has no symbol index";
+          continue;
+        }
+
+        if (const Archive::Member* member = archive.member_defining(symbol))
+          std::cout << name << "(" << member->name << ")\n";
+      } catch (const std::exception& ex) {
+        LOG(warning) << "Unable to read " << name << ": " << ex.what();
+      }
+    }
+  } else {
+    while (stm.executeStep()) {
+      std::cout << stm.getColumn(0).getString() << " : " << stm.getColumn(1).getString() << "\n";
+    }
   }
 
   std::flush(std::cout);
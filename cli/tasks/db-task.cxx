@@ -10,6 +10,7 @@ boost::program_options::options_description DB_Task::options()
 {
   bpo::options_description opt("Options");
   opt.add_options()
+      ("stats", "Print the size of the tables and the storage settings.")
       ("clear-symbols", "Clear the symbols table.")
       ("optimize", "Optimize database.")
       ("vacuum", "Vacuum (compact) database.");
@@ -36,4 +37,14 @@ void DB_Task::execute(Database3& db)
   if (vm.count("vacuum")) {
     db.vacuum();
   }
+
+  if (vm.count("stats")) {
+    std::cout << "artifacts: " << db.count_artifacts() << "\n"
+              << "dependencies: " << db.count_dependencies() << "\n"
+              << "symbols: " << db.count_symbols() << "\n"
+              << "symbol references: " << db.count_symbol_references() << "\n";
+
+    for(const auto& setting : db.storage_settings())
+      std::cout << setting.first << ": " << setting.second << "\n";
+  }
 }
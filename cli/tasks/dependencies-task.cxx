@@ -101,7 +101,7 @@ void get_dependencies_for(Database2& db,
                           const std::vector<std::string>& excluded_types,
                           std::set<Dependency>& dependencies)
 {
-  SQLite::Statement dependencies_stm = db.build_get_depend_stm("dependency_id", "dependee_id", included_types, excluded_types);
+  SQLite::Statement& dependencies_stm = db.build_get_depend_stm("dependency_id", "dependee_id", included_types, excluded_types);
   dependencies_stm.bind(1, artifact_id);
   for(long long dependency_id : Database2::get_ids(dependencies_stm)) {
     dependencies.emplace(artifact_id, dependency_id);
@@ -114,7 +114,7 @@ void get_dependees_for(Database2& db,
                        const std::vector<std::string>& excluded_types,
                        std::set<Dependency>& dependencies)
 {
-  SQLite::Statement dependees_stm = db.build_get_depend_stm("dependee_id", "dependency_id", included_types, excluded_types);
+  SQLite::Statement& dependees_stm = db.build_get_depend_stm("dependee_id", "dependency_id", included_types, excluded_types);
   dependees_stm.bind(1, artifact_id);
 
   for(long long dependee_id : Database2::get_ids(dependees_stm)) {
@@ -128,7 +128,7 @@ void get_all_dependencies_for(Database2& db,
                               const std::vector<std::string>& excluded_types,
                               std::set<Dependency>& dependencies)
 {
-  SQLite::Statement dependencies_stm = db.build_get_depend_stm("dependency_id", "dependee_id", included_types, excluded_types);
+  SQLite::Statement& dependencies_stm = db.build_get_depend_stm("dependency_id", "dependee_id", included_types, excluded_types);
 
   std::set<long long> visited, queue = {artifact_id};
 
@@ -157,7 +157,7 @@ void get_all_dependees_for(Database2& db,
                            const std::vector<std::string>& excluded_types,
                            std::set<Dependency>& dependencies)
 {
-  SQLite::Statement dependees_stm = db.build_get_depend_stm("dependee_id", "dependency_id", included_types, excluded_types);
+  SQLite::Statement& dependees_stm = db.build_get_depend_stm("dependee_id", "dependency_id", included_types, excluded_types);
 
   std::set<long long> visited, queue = {artifact_id};
 
@@ -200,18 +200,14 @@ std::set<long long> list_artifacts(const std::set<Dependency>& dependencies)
   return ids;
 }
 
-std::string build_artifacts_query(const std::set<long long>& artifacts)
-{
-  std::stringstream ss;
-  ss << "select id, name, type from artifacts where id in " << in_expr(std::vector<long long>(artifacts.begin(), artifacts.end()));
-  return ss.str();
-}
-
 std::map<long long, ArtifactData> map_artifacts(Database2& db, const std::set<Dependency>& dependencies, const bool path)
 {
   std::map<long long, ArtifactData> mapping;
 
-  SQLite::Statement q = db.statement(build_artifacts_query(list_artifacts(dependencies)));
+  const std::set<long long> artifacts = list_artifacts(dependencies);
+
+  SQLite::Statement& q = db.cached_statement("select id, name, type from artifacts where id in (select value from json_each(?))");
+  Database2::bind_ids(q, 1, std::vector<long long>(artifacts.begin(), artifacts.end()));
 
   size_t i = 0;
   while (q.executeStep()) {
@@ -397,6 +393,11 @@ void Dependencies_Task::parse_args(const std::vector<std::string>& args)
   }
 }
 
+StorageProfile Dependencies_Task::storage_profile() const
+{
+  return StorageProfile::query;
+}
+
 void Dependencies_Task::execute(Database3& db)
 {
   const bool follow = vm.count("follow") > 0;
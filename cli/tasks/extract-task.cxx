@@ -22,6 +22,9 @@ boost::program_options::options_description Extract_Task::options()
   opt.add_options()
       ("dependencies", "Extract dependencies from commands.")
       ("symbols", "Extract symbols from artifacts.")
+      (",j",
+       bpo::value<unsigned int>(&mNumThreads)->default_value(0, "auto"),
+       "Number of parallel threads to run, one per hardware thread by default.")
       ;
 
   return opt;
@@ -33,6 +36,11 @@ void Extract_Task::parse_args(const std::vector<std::string>& args)
   bpo::notify(vm);
 }
 
+StorageProfile Extract_Task::storage_profile() const
+{
+  return StorageProfile::bulk;
+}
+
 void Extract_Task::execute(Database3& db)
 {
   if (vm.count("dependencies")) {
@@ -40,6 +48,7 @@ void Extract_Task::execute(Database3& db)
   }
 
   if (vm.count("symbols")) {
+    db.set_jobs(mNumThreads);
     db.load_symbols();
   }
 }
@@ -120,6 +120,9 @@ boost::program_options::options_description ImportCommand_Task::options()
        "Use - to read from the standard input (default).")
       ("extract-dependencies", "Extract dependencies from the stored commands.")
       ("extract-symbols", "Extract symbols from artifacts.")
+      (",j",
+       bpo::value<unsigned int>(&mNumThreads)->default_value(0, "auto"),
+       "Number of parallel threads parsing the list of commands and extracting symbols, one per hardware thread by default.")
       ;
 
   return opt;
@@ -136,9 +139,14 @@ void ImportCommand_Task::parse_args(const std::vector<std::string>& args)
   }
 }
 
+StorageProfile ImportCommand_Task::storage_profile() const
+{
+  return StorageProfile::bulk;
+}
+
 void ImportCommand_Task::execute(Database3& db)
 {
-  ConsoleCommandImporter importer(db);
+  ConsoleCommandImporter importer(db, mNumThreads);
 
   for(const auto& src : vm["json"].as<InputFiles>()) {
     LOG_CTX_FLUSH(info) << "Importing json compilation database from " << pretty_input_name(src);
@@ -177,6 +185,7 @@ void ImportCommand_Task::execute(Database3& db)
   }
 
   if (vm.count("extract-symbols")) {
+    db.set_jobs(mNumThreads);
     db.load_symbols();
   }
 }
@@ -9,6 +9,7 @@ class ImportCommand_Task : public Task
 {
 private:
   boost::program_options::variables_map vm;
+  unsigned int mNumThreads = 0;
 
 public:
   using Task::Task;
@@ -16,6 +17,7 @@ public:
   boost::program_options::options_description options() override;
   void parse_args(const std::vector<std::string>& args) override;
   void execute(Database3& db) override;
+  StorageProfile storage_profile() const override;
 };
 
 #endif // IMPORTCOMMANDTASK_HXX
@@ -1,10 +1,17 @@
 #ifndef ARTIFACTS_SYMBOL_HXX
 #define ARTIFACTS_SYMBOL_HXX
 
+#include <string>
+
 #include "SymbolReferenceSet.hxx"
 
 struct ArtifactSymbols {
   SymbolReferenceSet undefined, external, internal;
 };
 
+struct ArchiveMemberSymbols {
+  std::string member;
+  ArtifactSymbols symbols;
+};
+
 #endif /* ARTIFACTS_SYMBOL_HXX */
@@ -2,13 +2,24 @@
 
 #include <iostream>
 #include <sstream>
-#include <cxxabi.h>
 #include <algorithm>
 #include <cctype>
+#include <charconv>
+#include <stdexcept>
+
+#include <SQLiteCpp/Transaction.h>
+
+#include <shellwords/shellwords.hxx>
 
 #include "ArtifactSymbols.hxx"
+#include "command-utils.hxx"
+#include "file-identity.hxx"
 #include "SymbolReference.hxx"
 #include "query-utils.hxx"
+#include "utils.hxx"
+#include "logger.hxx"
+
+#include <omp.h>
 
 namespace {
 
@@ -17,13 +28,71 @@ bool valid_symbol_char(const char c)
   return isalnum(c) != 0 || c == '_' || c == '$' || c == '.';
 }
 
+std::string multi_row_insert(const std::string& insert, const std::string& table, const std::vector<std::string>& columns, const size_t rows)
+{
+  std::stringstream ss;
+  ss << insert << " into " << table << " (";
+  for(size_t c = 0; c < columns.size(); ++c)
+    ss << (c > 0 ? ", " : "") << columns[c];
+  ss << ") values ";
+
+  for(size_t r = 0; r < rows; ++r) {
+    ss << (r > 0 ? ", (" : "(");
+    for(size_t c = 0; c < columns.size(); ++c)
+      ss << (c > 0 ? ", ?" : "?");
+    ss << ")";
+  }
+
+  return ss.str();
+}
+
+// Clustered on the artifact so that its references are stored together.
+// Outside archives member_id is 0, primary key columns cannot be null.
+// Lookups by symbol are covered by symbol_reference_by_symbol_category, which
+// also holds the primary key columns like every index of a WITHOUT ROWID table.
+const char* symbol_references_schema = R"(
+create table if not exists "symbol_references" (
+  "artifact_id" INTEGER NOT NULL REFERENCES "artifacts",
+  "category" INTEGER NOT NULL,
+  "symbol_id" INTEGER NOT NULL REFERENCES "symbols",
+  "member_id" INTEGER NOT NULL DEFAULT 0,
+  "type" INTEGER NOT NULL,
+  "size" INTEGER DEFAULT NULL,
+  PRIMARY KEY ("artifact_id", "category", "symbol_id", "member_id")
+) WITHOUT ROWID;
+drop index if exists "symbol_reference_by_symbol";
+create index if not exists "symbol_reference_by_symbol_category" on "symbol_references" ("symbol_id", "category", "artifact_id", "size");
+)";
+
 } // anonymous namespace
 
+SymbolCategory symbol_category(const std::string& name)
+{
+  if (name == "undefined")
+    return undefined_symbol;
+  else if (name == "external")
+    return external_symbol;
+  else if (name == "internal")
+    return internal_symbol;
+  else
+    throw std::invalid_argument("Unknown symbol category: " + name);
+}
+
+const char* symbol_category_name(SymbolCategory category)
+{
+  switch (category) {
+  case undefined_symbol: return "undefined";
+  case external_symbol: return "external";
+  case internal_symbol: return "internal";
+  }
+  return "";
+}
+
 #define LAZYSTM(stm) [this]{ return new SQLite::Statement(db, stm); }
 
-Database2::Database2(const std::string& file)
-  : db(file, SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE)
-  , create_command_stm(LAZYSTM("insert into commands (directory, executable, args) values (?, ?, ?)"))
+Database2::Database2(const std::string& file, OpenMode mode)
+  : db(file, mode == OpenMode::read_only ? SQLite::OPEN_READONLY : SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE)
+  , create_command_stm(LAZYSTM("insert into commands (directory, executable, args, argv) values (?, ?, ?, ?)"))
   , create_artifact_stm(LAZYSTM("insert into artifacts (name, type, generating_command_id) values (?, ?, ?)"))
   , artifact_id_by_name_stm(LAZYSTM("select id from artifacts where name = ?"))
   , artifact_name_by_id_stm(LAZYSTM("select name from artifacts where id = ?"))
@@ -32,15 +101,36 @@ Database2::Database2(const std::string& file)
   , artifact_set_type_stm(LAZYSTM("update artifacts set type = ? where id = ?"))
   , create_symbol_stm(LAZYSTM("insert into symbols (name, dname) values (?, ?)"))
   , symbol_id_by_name_stm(LAZYSTM("select id from symbols where name = ?"))
-  , create_symbol_reference_stm(LAZYSTM("insert into symbol_references (artifact_id, symbol_id, category, type, size) values (?, ?, ?, ?, ?)"))
-  , create_dependency_stm(LAZYSTM("insert into dependencies (dependee_id, dependency_id) values (?, ?)"))
+  , symbol_set_dname_stm(LAZYSTM("update symbols set dname = ? where id = ?"))
+  , create_symbol_reference_stm(LAZYSTM("insert or ignore into symbol_references (artifact_id, symbol_id, category, type, size, member_id) values (?, ?, ?, ?, ?, ?)"))
+  , create_symbol_references_stm(LAZYSTM(multi_row_insert("insert or ignore", "symbol_references", {"artifact_id", "symbol_id", "category", "type", "size", "member_id"}, symbol_references_per_insert)))
+  , create_archive_member_stm(LAZYSTM("insert into archive_members (artifact_id, name) values (?, ?)"))
+  , delete_symbol_references_stm(LAZYSTM("delete from symbol_references where artifact_id = ?"))
+  , delete_archive_members_stm(LAZYSTM("delete from archive_members where artifact_id = ?"))
+  , set_artifact_identity_stm(LAZYSTM("insert or replace into artifact_files (artifact_id, device, inode, size, mtime_ns, build_id) values (?, ?, ?, ?, ?, ?)"))
+  , delete_artifact_identity_stm(LAZYSTM("delete from artifact_files where artifact_id = ?"))
+  , create_dependency_stm(LAZYSTM("insert or ignore into dependencies (dependee_id, dependency_id) values (?, ?)"))
   , find_dependencies_stm(LAZYSTM("select dependency_id from dependencies where dependee_id = ?"))
   , find_dependees_stm(LAZYSTM("select dependee_id from dependencies where dependency_id = ?"))
   , get_sources_stm(LAZYSTM(R"(select artifacts.name from artifacts
 inner join dependencies on dependencies.dependency_id = artifacts.id
 where dependencies.dependee_id = ? and artifacts.type = "source")"))
-  , undefined_symbols_stm(LAZYSTM("select symbol_id from symbol_references where category = \"undefined\" and artifact_id = ?"))
+  , undefined_symbols_stm(LAZYSTM("select symbol_id from symbol_references where artifact_id = ? and category = " + std::to_string(undefined_symbol)))
+  , resolve_symbols_stm(LAZYSTM(R"(
+select symbol_references.symbol_id, artifacts.name, archive_members.name from symbol_references
+inner join artifacts on artifacts.id = symbol_references.artifact_id
+left join archive_members on archive_members.id = symbol_references.member_id
+where symbol_references.category = )" + std::to_string(external_symbol) + R"(
+and symbol_references.symbol_id in (select value from json_each(?)))"))
+  , mOpenMode(mode)
 {
+  if (mode == OpenMode::read_only) {
+    // Waits for a writer holding its exclusive lock instead of failing with SQLITE_BUSY.
+    db.setBusyTimeout(60000);
+    check_schema();
+    return;
+  }
+
   db.exec("PRAGMA encoding='UTF-8';");
   db.exec("PRAGMA journal_mode=WAL;");
   db.exec("PRAGMA page_size=65536;");
@@ -57,7 +147,8 @@ create table if not exists "commands" (
   "id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,
   "directory" VARCHAR(256) NOT NULL,
   "executable" VARCHAR(256) NOT NULL,
-  "args" TEXT NOT NULL
+  "args" TEXT NOT NULL,
+  "argv" BLOB NOT NULL
 );
 create unique index if not exists "unique_commands" on "commands" ("directory", "executable", "args");
 
@@ -86,36 +177,141 @@ create table if not exists "symbols" (
 create unique index if not exists "unique_symbol" on "symbols" ("name");
 create index if not exists "symbol_by_dname" on "symbols" ("dname");
 
-create table if not exists "symbol_references" (
+create table if not exists "archive_members" (
   "id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,
   "artifact_id" INTEGER NOT NULL REFERENCES "artifacts",
-  "symbol_id" INTEGER NOT NULL REFERENCES "symbols",
-  "category" VARCHAR(16) NOT NULL,
-  "type" VARCHAR(1) NOT NULL,
-  "size" INTEGER DEFAULT NULL
+  "name" VARCHAR(256) NOT NULL
+);
+create index if not exists "archive_member_by_artifact" on "archive_members" ("artifact_id");
+
+create table if not exists "artifact_files" (
+  "artifact_id" INTEGER NOT NULL PRIMARY KEY REFERENCES "artifacts",
+  "device" INTEGER NOT NULL,
+  "inode" INTEGER NOT NULL,
+  "size" INTEGER NOT NULL,
+  "mtime_ns" INTEGER NOT NULL,
+  "build_id" TEXT DEFAULT NULL
 );
-create index if not exists "symbol_reference_by_artifact" on "symbol_references" ("artifact_id");
-create index if not exists "symbol_reference_by_symbol" on "symbol_references" ("symbol_id");
-create index if not exists "symbol_reference_by_category" on "symbol_references" ("category");
-create index if not exists "symbol_reference_by_type" on "symbol_references" ("type");
 
 create table if not exists "timestamps" (
   "id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,
   "name" VARCHAR(16) UNIQUE NOT NULL,
   "time" INTEGER NOT NULL
 );
+
+create table if not exists "progress" (
+  "name" VARCHAR(32) NOT NULL PRIMARY KEY,
+  "position" INTEGER NOT NULL
+);
 )";
 
+  auto version_stm = statement("PRAGMA user_version");
+  const long long version = get_id(version_stm);
+
+  if (version > schema_version)
+    throw std::runtime_error("Database schema version " + std::to_string(version) + " is newer than the supported version " + std::to_string(schema_version));
+
   db.exec(queries);
+
+  if (version < 1 && has_table("symbol_references"))
+    migrate_symbol_references();
+  else
+    db.exec(symbol_references_schema);
+
+  if (version < 2 && !has_column("commands", "argv"))
+    migrate_command_argv();
+
+  db.exec("PRAGMA user_version=" + std::to_string(schema_version) + ";");
+}
+
+void Database2::check_schema()
+{
+  auto version_stm = statement("PRAGMA user_version");
+  const long long version = get_id(version_stm);
+
+  if (version != schema_version)
+    throw std::runtime_error("Database schema version " + std::to_string(version) + " differs from the supported version "
+                             + std::to_string(schema_version) + ", it must be opened read-write first");
+}
+
+void Database2::migrate_symbol_references()
+{
+  LOG(info) << "Migrating symbol references to schema version 1";
+
+  // Databases created before archives were supported.
+  const char* member_id = has_column("symbol_references", "member_id") ? R"(coalesce("member_id", 0))" : "0";
+
+  // Duplicated references, such as different versions of a same symbol, are merged.
+  std::stringstream ss;
+  ss << R"(
+alter table "symbol_references" rename to "symbol_references_v0";
+drop index if exists "symbol_reference_by_artifact";
+drop index if exists "symbol_reference_by_symbol";
+drop index if exists "symbol_reference_by_category";
+drop index if exists "symbol_reference_by_type";
+)" << symbol_references_schema << R"(
+insert or ignore into "symbol_references" ("artifact_id", "category", "symbol_id", "member_id", "type", "size")
+select "artifact_id",
+       case "category" when 'undefined' then )" << undefined_symbol << R"( when 'external' then )" << external_symbol << " else " << internal_symbol << R"( end,
+       "symbol_id", )" << member_id << R"(, unicode("type"), "size"
+from "symbol_references_v0";
+drop table "symbol_references_v0";
+)";
+
+  SQLite::Transaction transaction(db);
+  db.exec(ss.str());
+  transaction.commit();
+}
+
+void Database2::migrate_command_argv()
+{
+  LOG(info) << "Migrating commands to schema version 2";
+
+  SQLite::Transaction transaction(db);
+
+  db.exec(R"(alter table "commands" add column "argv" BLOB NOT NULL DEFAULT x'';)");
+
+  // Split one last time, later reads decode the stored arguments.
+  auto select = statement("select id, args from commands");
+  auto update = statement("update commands set argv = ? where id = ?");
+
+  while (select.executeStep()) {
+    const std::string argv = encode_argv(shellwords::shellsplit(select.getColumn(1).getString()));
+    update.bind(1, argv.data(), static_cast<int>(argv.size()));
+    update.bind(2, select.getColumn(0).getInt64());
+    update.exec();
+    update.reset();
+  }
+
+  transaction.commit();
+}
+
+bool Database2::has_table(const std::string& table)
+{
+  auto stm = statement("select count(*) from sqlite_master where type = 'table' and name = ?");
+  stm.bind(1, table);
+  return get_id(stm) > 0;
+}
+
+bool Database2::has_column(const std::string& table, const std::string& column)
+{
+  auto stm = statement("select count(*) from pragma_table_info(?) where name = ?");
+  stm.bind(1, table);
+  stm.bind(2, column);
+  return get_id(stm) > 0;
 }
 
 void Database2::truncate_symbols() {
   db.exec("delete from symbols;");
+  mSymbolIds.clear();
+  mUndemangledSymbols.clear();
   truncate_symbol_references();
 }
 
 void Database2::truncate_symbol_references() {
   db.exec("delete from symbol_references;");
+  db.exec("delete from archive_members;");
+  db.exec("delete from artifact_files;");
 }
 
 SQLite::Statement Database2::statement(const std::string& query)
@@ -123,6 +319,36 @@ SQLite::Statement Database2::statement(const std::string& query)
   return SQLite::Statement(db, query);
 }
 
+SQLite::Statement& Database2::cached_statement(const std::string& query)
+{
+  const auto found = mStatementCacheIndex.find(query);
+  if (found != mStatementCacheIndex.end()) {
+    ++mStatementCacheStats.hits;
+    mStatementCache.splice(mStatementCache.begin(), mStatementCache, found->second);
+
+    SQLite::Statement& stm = *found->second->second;
+    stm.reset();
+    stm.clearBindings();
+    return stm;
+  }
+
+  ++mStatementCacheStats.misses;
+
+  const auto start = std::chrono::steady_clock::now();
+  auto stm = std::make_unique<SQLite::Statement>(db, query);
+  mStatementCacheStats.prepare += std::chrono::steady_clock::now() - start;
+
+  if (mStatementCache.size() >= statement_cache_size) {
+    mStatementCacheIndex.erase(mStatementCache.back().first);
+    mStatementCache.pop_back();
+  }
+
+  mStatementCache.emplace_front(query, std::move(stm));
+  mStatementCacheIndex.emplace(query, mStatementCache.begin());
+
+  return *mStatementCache.front().second;
+}
+
 void Database2::optimize()
 {
   db.exec("analyze;");
@@ -133,17 +359,67 @@ void Database2::vacuum()
   db.exec("vacuum;");
 }
 
+void Database2::set_storage_profile(StorageProfile profile)
+{
+  mStorageProfile = profile;
+
+  // Negative cache sizes are in KiB. Memory mapped reads skip the copy into the page cache.
+  switch (profile) {
+  case StorageProfile::bulk:
+    db.exec("PRAGMA cache_size=-262144;");
+    db.exec("PRAGMA mmap_size=268435456;");
+    db.exec("PRAGMA temp_store=MEMORY;");
+    break;
+  case StorageProfile::query:
+    db.exec("PRAGMA cache_size=-65536;");
+    db.exec("PRAGMA mmap_size=1073741824;");
+    db.exec("PRAGMA temp_store=MEMORY;");
+    break;
+  case StorageProfile::lowmem:
+    db.exec("PRAGMA cache_size=-2000;");
+    db.exec("PRAGMA mmap_size=0;");
+    db.exec("PRAGMA temp_store=FILE;");
+    break;
+  }
+}
+
+std::vector<std::pair<std::string, std::string>> Database2::storage_settings()
+{
+  std::vector<std::pair<std::string, std::string>> settings;
+
+  for(const std::string pragma : {"journal_mode", "locking_mode", "synchronous", "page_size", "cache_size", "mmap_size", "temp_store"}) {
+    auto stm = statement("PRAGMA " + pragma);
+    std::string value = stm.executeStep() ? stm.getColumn(0).getString() : std::string();
+
+    if (pragma == "cache_size" && !value.empty() && value.front() == '-')
+      value = value.substr(1) + " KiB";
+    else if (pragma == "temp_store")
+      value = value == "2" ? "memory" : value == "1" ? "file" : "default";
+
+    settings.emplace_back(pragma, std::move(value));
+  }
+
+  return settings;
+}
+
+bool Database2::is_empty(const std::string& table)
+{
+  auto stm = statement("select not exists (select 1 from \"" + table + "\")");
+  return get_id(stm) != 0;
+}
+
 long long Database2::last_id()
 {
   return db.getLastInsertRowid();
 }
 
-long long Database2::create_command(const std::string& directory, const std::string& executable, const std::string& args) {
+long long Database2::create_command(const std::string& directory, const std::string& executable, const std::string& args, const std::string& argv) {
   auto& stm = *create_command_stm;
 
   stm.bind(1, directory);
   stm.bind(2, executable);
   stm.bind(3, args);
+  stm.bindNoCopy(4, argv.data(), static_cast<int>(argv.size()));
   stm.exec();
   stm.reset();
   stm.clearBindings();
@@ -234,22 +510,39 @@ long long Database2::count_symbols()
 }
 
 void Database2::create_symbol(const std::string& name) {
-  int status;
-
-  char* dname = abi::__cxa_demangle(name.c_str(), 0, 0, &status);
-
   auto& stm = *create_symbol_stm;
 
+  // Demangling is expensive, it is left to demangle_symbols().
   stm.bind(1, name);
-  if (status == 0)
-    stm.bind(2, dname);
-  else
-    stm.bind(2, "");
+  stm.bind(2, "");
   stm.exec();
   stm.reset();
   stm.clearBindings();
 
-  free(dname);
+  const long long id = db.getLastInsertRowid();
+
+  if (mSymbolIdsLoaded)
+    mSymbolIds.emplace(name, id);
+
+  if (starts_with(name, "_Z"))
+    mUndemangledSymbols.emplace_back(id, name);
+}
+
+long long Database2::get_or_create_symbol(const std::string& name)
+{
+  if (!mSymbolIdsLoaded) {
+    auto stm = statement("select name, id from symbols");
+    while (stm.executeStep())
+      mSymbolIds.emplace(stm.getColumn(0).getString(), stm.getColumn(1).getInt64());
+    mSymbolIdsLoaded = true;
+  }
+
+  const auto it = mSymbolIds.find(name);
+  if (it != mSymbolIds.end())
+    return it->second;
+
+  create_symbol(name);
+  return db.getLastInsertRowid();
 }
 
 int Database2::symbol_id_by_name(const std::string& name) {
@@ -259,49 +552,156 @@ int Database2::symbol_id_by_name(const std::string& name) {
   return get_id(stm);
 }
 
+void Database2::demangle_symbols(size_t threads)
+{
+  std::vector<std::string> dnames(mUndemangledSymbols.size());
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 256)
+  for(size_t i = 0; i < mUndemangledSymbols.size(); ++i)
+    dnames[i] = demangle(mUndemangledSymbols[i].second);
+
+  auto& stm = *symbol_set_dname_stm;
+  for(size_t i = 0; i < mUndemangledSymbols.size(); ++i) {
+    if (dnames[i].empty())
+      continue;
+
+    stm.bind(1, dnames[i]);
+    stm.bind(2, mUndemangledSymbols[i].first);
+    stm.exec();
+    stm.reset();
+    stm.clearBindings();
+  }
+
+  mUndemangledSymbols.clear();
+}
+
 long long Database2::count_symbol_references()
 {
   auto stm = statement("select count(*) from symbol_references");
   return get_id(stm);
 }
 
-void Database2::create_symbol_reference(long long artifact_id, long long symbol_id, const char* category, const char type, long long size) {
+void Database2::create_symbol_reference(long long artifact_id, long long symbol_id, SymbolCategory category, const char type, long long size, long long member_id) {
   auto& stm = *create_symbol_reference_stm;
 
-  const char type_str[2] = {type, 0};
-
   stm.bind(1, artifact_id);
   stm.bind(2, symbol_id);
   stm.bind(3, category);
-  stm.bind(4, type_str);
+  stm.bind(4, static_cast<unsigned char>(type));
   stm.bind(5, size);
+  stm.bind(6, std::max(member_id, 0LL));
 
   stm.exec();
   stm.reset();
   stm.clearBindings();
 }
 
-void Database2::insert_symbol_references(long long artifact_id, const SymbolReferenceSet& symbols, const char* category) {
+void Database2::insert_symbol_references(long long artifact_id, const SymbolReferenceSet& symbols, SymbolCategory category, long long member_id) {
+  struct Row {
+    long long symbol_id;
+    char type;
+    long long size;
+  };
+
+  std::vector<Row> rows; rows.reserve(symbols.size());
+
   for(const SymbolReference& symbol : symbols) {
 
     // Strip symbol version
     auto first_invalid_char = std::find_if_not(symbol.name.begin(), symbol.name.end(), valid_symbol_char);
     const std::string symbol_name(symbol.name.cbegin(), first_invalid_char);
 
-    long long symbol_id = symbol_id_by_name(symbol_name);
-    if (symbol_id == -1) {
-      create_symbol(symbol_name);
-      symbol_id = db.getLastInsertRowid();
+    rows.push_back({get_or_create_symbol(symbol_name), symbol.type, symbol.size});
+  }
+
+  // In primary key order, the rows are appended to the B-tree pages instead of being spread over them.
+  std::stable_sort(rows.begin(), rows.end(), [](const Row& lhs, const Row& rhs) {
+    return lhs.symbol_id < rhs.symbol_id;
+  });
+
+  size_t i = 0;
+
+  auto& stm = *create_symbol_references_stm;
+  for(; i + symbol_references_per_insert <= rows.size(); i += symbol_references_per_insert) {
+    int index = 1;
+    for(size_t j = i; j < i + symbol_references_per_insert; ++j) {
+      stm.bind(index++, artifact_id);
+      stm.bind(index++, rows[j].symbol_id);
+      stm.bind(index++, category);
+      stm.bind(index++, static_cast<unsigned char>(rows[j].type));
+      stm.bind(index++, rows[j].size);
+      stm.bind(index++, std::max(member_id, 0LL));
     }
 
-    create_symbol_reference(artifact_id, symbol_id, category, symbol.type, symbol.size);
+    stm.exec();
+    stm.reset();
+    stm.clearBindings();
   }
+
+  for(; i < rows.size(); ++i)
+    create_symbol_reference(artifact_id, rows[i].symbol_id, category, rows[i].type, rows[i].size, member_id);
 }
 
 void Database2::insert_symbol_references(long long artifact_id, const ArtifactSymbols& symbols) {
-  insert_symbol_references(artifact_id, symbols.undefined, "undefined");
-  insert_symbol_references(artifact_id, symbols.external, "external");
-  insert_symbol_references(artifact_id, symbols.internal, "internal");
+  insert_symbol_references(artifact_id, -1, symbols);
+}
+
+void Database2::insert_symbol_references(long long artifact_id, long long member_id, const ArtifactSymbols& symbols) {
+  insert_symbol_references(artifact_id, symbols.undefined, undefined_symbol, member_id);
+  insert_symbol_references(artifact_id, symbols.external, external_symbol, member_id);
+  insert_symbol_references(artifact_id, symbols.internal, internal_symbol, member_id);
+}
+
+long long Database2::create_archive_member(long long artifact_id, const std::string& name)
+{
+  auto& stm = *create_archive_member_stm;
+
+  stm.bind(1, artifact_id);
+  stm.bind(2, name);
+  stm.exec();
+  stm.reset();
+  stm.clearBindings();
+
+  return db.getLastInsertRowid();
+}
+
+void Database2::delete_symbol_references(long long artifact_id)
+{
+  // References first, they point to the archive members.
+  for(SQLite::Statement* stm : {delete_symbol_references_stm.get(), delete_archive_members_stm.get()}) {
+    stm->bind(1, artifact_id);
+    stm->exec();
+    stm->reset();
+    stm->clearBindings();
+  }
+}
+
+void Database2::set_artifact_identity(long long artifact_id, const FileIdentity& identity)
+{
+  auto& stm = *set_artifact_identity_stm;
+
+  stm.bind(1, artifact_id);
+  stm.bind(2, identity.device);
+  stm.bind(3, identity.inode);
+  stm.bind(4, identity.size);
+  stm.bind(5, identity.mtime_ns);
+  if (!identity.build_id.empty())
+    stm.bind(6, identity.build_id);
+  else
+    stm.bind(6);
+  stm.exec();
+  stm.reset();
+  stm.clearBindings();
+}
+
+void Database2::delete_artifact_identity(long long artifact_id)
+{
+  auto& stm = *delete_artifact_identity_stm;
+
+  stm.bind(1, artifact_id);
+  stm.exec();
+  stm.reset();
+  stm.clearBindings();
 }
 
 long long Database2::count_dependencies()
@@ -322,10 +722,10 @@ void Database2::create_dependency(long long dependee_id, long long dependency_id
   stm.clearBindings();
 }
 
-SQLite::Statement Database2::build_get_depend_stm(const std::string& select_field,
-                                                  const std::string& match_field,
-                                                  const std::vector<std::string>& included_types,
-                                                  const std::vector<std::string>& excluded_types)
+SQLite::Statement& Database2::build_get_depend_stm(const std::string& select_field,
+                                                   const std::string& match_field,
+                                                   const std::vector<std::string>& included_types,
+                                                   const std::vector<std::string>& excluded_types)
 {
   std::stringstream ss;
   ss << "select " << select_field << " from dependencies";
@@ -341,7 +741,7 @@ SQLite::Statement Database2::build_get_depend_stm(const std::string& select_fiel
   if (!excluded_types.empty())
     ss << " and artifacts.type not in " << in_expr(excluded_types);
 
-  return statement(ss.str());
+  return cached_statement(ss.str());
 }
 
 long long Database2::get_id(SQLite::Statement& stm) {
@@ -371,6 +771,24 @@ std::vector<long long> Database2::get_ids(SQLite::Statement& stm)
   return ids;
 }
 
+void Database2::bind_ids(SQLite::Statement& stm, int index, const std::vector<long long>& ids)
+{
+  std::string json;
+  json.reserve(ids.size() * 8 + 2);
+  json += '[';
+
+  char buffer[24];
+  for(size_t i = 0; i < ids.size(); ++i) {
+    if (i > 0)
+      json += ',';
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), ids[i]);
+    json.append(buffer, result.ptr);
+  }
+
+  json += ']';
+  stm.bind(index, json);
+}
+
 std::string Database2::get_string(SQLite::Statement& stm)
 {
   std::string str;
@@ -433,18 +851,17 @@ std::map<long long, std::vector<std::string> > Database2::resolve_symbols(const
 
   if (!symbols.empty())
   {
-    std::stringstream ss;
-    ss << R"(
-  select symbol_references.symbol_id, artifacts.name from symbol_references
-  inner join artifacts on artifacts.id = symbol_references.artifact_id
-  where symbol_references.category = "external"
-  and symbol_references.symbol_id in )" << in_expr(symbols);
-
-    SQLite::Statement stm = statement(ss.str());
+    auto& stm = *resolve_symbols_stm;
+    bind_ids(stm, 1, symbols);
 
     while(stm.executeStep()) {
-      symbol_locations[stm.getColumn(0).getInt64()].emplace_back(stm.getColumn(1).getString());
+      std::string location = stm.getColumn(1).getString();
+      if (!stm.getColumn(2).isNull())
+        location += "(" + stm.getColumn(2).getString() + ")";
+      symbol_locations[stm.getColumn(0).getInt64()].emplace_back(std::move(location));
     }
+    stm.reset();
+    stm.clearBindings();
   }
 
   return symbol_locations;
@@ -471,3 +888,84 @@ void Database2::set_timestamp(const std::string& name, const std::chrono::high_r
   stm.bind(2, std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count());
   stm.exec();
 }
+
+long long Database2::get_progress(const std::string& name)
+{
+  auto stm = statement("select position from progress where name = ?");
+  stm.bind(1, name);
+  return get_id(stm);
+}
+
+void Database2::set_progress(const std::string& name, long long position)
+{
+  auto stm = statement("insert or replace into progress (name, position) values (?, ?)");
+  stm.bind(1, name);
+  stm.bind(2, position);
+  stm.exec();
+}
+
+void Database2::clear_progress(const std::string& name)
+{
+  auto stm = statement("delete from progress where name = ?");
+  stm.bind(1, name);
+  stm.exec();
+}
+
+void Database2::set_checkpoint_interval(size_t steps, std::chrono::seconds period)
+{
+  mCheckpointSteps = steps;
+  mCheckpointPeriod = period;
+  mStepsSinceCheckpoint = 0;
+  mLastCheckpoint = std::chrono::steady_clock::now();
+}
+
+bool Database2::checkpoint_due(size_t steps)
+{
+  mStepsSinceCheckpoint += steps;
+
+  return (mCheckpointSteps > 0 && mStepsSinceCheckpoint >= mCheckpointSteps)
+      || (mCheckpointPeriod.count() > 0 && std::chrono::steady_clock::now() - mLastCheckpoint >= mCheckpointPeriod);
+}
+
+void Database2::checkpoint()
+{
+  db.exec("commit; begin;");
+
+  ++mCheckpoints;
+  mStepsSinceCheckpoint = 0;
+  mLastCheckpoint = std::chrono::steady_clock::now();
+}
+
+BulkLoad::BulkLoad(Database2& db, const std::vector<std::string>& tables)
+  : mDb(db)
+{
+  // Unique indexes are kept, the loaders rely on them to find existing rows.
+  auto stm = mDb.statement(R"(select sqlite_master.name, sqlite_master.sql from pragma_index_list(?) as indexes
+inner join sqlite_master on sqlite_master.name = indexes.name
+where indexes."unique" = 0 and indexes.origin = 'c')");
+
+  std::vector<std::string> names;
+  for(const std::string& table : tables) {
+    stm.bind(1, table);
+    while (stm.executeStep()) {
+      names.emplace_back(stm.getColumn(0).getString());
+      mIndexes.emplace_back(stm.getColumn(1).getString());
+    }
+    stm.reset();
+  }
+
+  for(const std::string& name : names)
+    mDb.database().exec("drop index \"" + name + "\";");
+}
+
+BulkLoad::~BulkLoad()
+{
+  for(const std::string& index : mIndexes) {
+    try {
+      mDb.database().exec(index);
+    } catch (const std::exception& ex) {
+      // Indexes of the schema are created again when the database is next opened.
+      LOG_EX(error, ex);
+    }
+  }
+}
@@ -2,9 +2,12 @@
 #define DATABASE2_HXX
 
 #include <chrono>
+#include <list>
+#include <memory>
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <functional>
 
 #include <boost/core/noncopyable.hpp>
@@ -15,6 +18,7 @@
 #include "SymbolReferenceSet.hxx"
 
 struct ArtifactSymbols;
+struct FileIdentity;
 
 template <typename T>
 class Lazy : boost::noncopyable {
@@ -33,6 +37,30 @@ public:
   inline T * operator->() const { return get(); }
 };
 
+// Values of symbol_references.category.
+enum SymbolCategory : int {
+  undefined_symbol = 0,
+  external_symbol = 1,
+  internal_symbol = 2
+};
+
+// Throws std::invalid_argument for names other than undefined, external and internal.
+SymbolCategory symbol_category(const std::string& name);
+
+const char* symbol_category_name(SymbolCategory category);
+
+// Page cache, memory mapping and temporary storage settings, see Database2::set_storage_profile().
+enum class StorageProfile {
+  bulk,   // Large page cache for index updates, while importing and extracting.
+  query,  // Database file mapped in memory, for the analyses.
+  lowmem  // SQLite defaults, temporary tables and sorts on disk.
+};
+
+enum class OpenMode {
+  read_write, // Creates or migrates the schema, locks the database until closed.
+  read_only   // Shared locking, for queries running next to other readers.
+};
+
 class Artifact {
 public:
   long long id = -1;
@@ -66,6 +94,13 @@ template<> struct less<Dependency>
 
 } // namespace std
 
+struct StatementCacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  // Spent in sqlite3_prepare() by the misses.
+  std::chrono::nanoseconds prepare{0};
+};
+
 class Database2 {
 public:
   SQLite::Database db;
@@ -80,17 +115,60 @@ private:
   Lazy<SQLite::Statement> artifact_set_type_stm;
   Lazy<SQLite::Statement> create_symbol_stm;
   Lazy<SQLite::Statement> symbol_id_by_name_stm;
+  Lazy<SQLite::Statement> symbol_set_dname_stm;
   Lazy<SQLite::Statement> create_symbol_reference_stm;
+  Lazy<SQLite::Statement> create_symbol_references_stm;
+  Lazy<SQLite::Statement> create_archive_member_stm;
+  Lazy<SQLite::Statement> delete_symbol_references_stm;
+  Lazy<SQLite::Statement> delete_archive_members_stm;
+  Lazy<SQLite::Statement> set_artifact_identity_stm;
+  Lazy<SQLite::Statement> delete_artifact_identity_stm;
   Lazy<SQLite::Statement> create_dependency_stm;
   Lazy<SQLite::Statement> find_dependencies_stm;
   Lazy<SQLite::Statement> find_dependees_stm;
   Lazy<SQLite::Statement> get_sources_stm;
   Lazy<SQLite::Statement> undefined_symbols_stm;
+  Lazy<SQLite::Statement> resolve_symbols_stm;
+
+  // Statements built at run time by SQL text, most recently used first.
+  using CachedStatement = std::pair<std::string, std::unique_ptr<SQLite::Statement>>;
+  std::list<CachedStatement> mStatementCache;
+  std::unordered_map<std::string, std::list<CachedStatement>::iterator> mStatementCacheIndex;
+  StatementCacheStats mStatementCacheStats;
+
+  const OpenMode mOpenMode;
+
+  // Chunked commits, disabled when both are 0.
+  size_t mCheckpointSteps = 0;
+  std::chrono::seconds mCheckpointPeriod{0};
+  size_t mStepsSinceCheckpoint = 0;
+  std::chrono::steady_clock::time_point mLastCheckpoint;
+  size_t mCheckpoints = 0;
+  StorageProfile mStorageProfile = StorageProfile::lowmem;
+
+  // Symbol name -> id, loaded from the symbols table on first use and kept up to date by create_symbol().
+  std::unordered_map<std::string, long long> mSymbolIds;
+  bool mSymbolIdsLoaded = false;
+
+  // Symbols created with an empty dname, demangled in a batch by demangle_symbols().
+  std::vector<std::pair<long long, std::string>> mUndemangledSymbols;
 
   void create();
+  void check_schema();
+  void migrate_symbol_references();
+  void migrate_command_argv();
+  bool has_table(const std::string& table);
+  bool has_column(const std::string& table, const std::string& column);
+
+  long long get_or_create_symbol(const std::string& name);
 
 public:
-  explicit Database2(const std::string& file);
+  // Stored in PRAGMA user_version, databases created before versioning are version 0.
+  static constexpr int schema_version = 2;
+
+  explicit Database2(const std::string& file, OpenMode mode = OpenMode::read_write);
+
+  bool read_only() const { return mOpenMode == OpenMode::read_only; }
 
   void truncate_symbols();
   void truncate_symbol_references();
@@ -98,12 +176,30 @@ public:
   SQLite::Database& database() { return db; };
   SQLite::Statement statement(const std::string& query);
 
+  static constexpr size_t statement_cache_size = 64;
+
+  // Prepared on the first use of the query and owned by the cache, which drops the least recently
+  // used statement beyond statement_cache_size queries. Returned reset, without bindings.
+  SQLite::Statement& cached_statement(const std::string& query);
+
+  const StatementCacheStats& statement_cache_stats() const { return mStatementCacheStats; }
+
   void optimize();
   void vacuum();
 
+  void set_storage_profile(StorageProfile profile);
+
+  StorageProfile storage_profile() const { return mStorageProfile; }
+
+  // Name and current value of the PRAGMAs set by the constructor and set_storage_profile().
+  std::vector<std::pair<std::string, std::string>> storage_settings();
+
+  bool is_empty(const std::string& table);
+
   long long last_id();
 
-  long long create_command(const std::string& directory, const std::string& executable, const std::string& args);
+  // argv: the arguments encoded by encode_argv().
+  long long create_command(const std::string& directory, const std::string& executable, const std::string& args, const std::string& argv);
 
   long long count_artifacts();
 
@@ -127,22 +223,39 @@ public:
 
   int symbol_id_by_name(const std::string& name);
 
+  // Fills dname for the symbols created since the last call, demangling in parallel.
+  void demangle_symbols(size_t threads);
+
   long long count_symbol_references();
 
-  void create_symbol_reference(long long artifact_id, long long symbol_id, const char* category, const char type, long long size);
+  // A reference already recorded for the same artifact, category, symbol and member is ignored.
+  void create_symbol_reference(long long artifact_id, long long symbol_id, SymbolCategory category, const char type, long long size, long long member_id = -1);
 
-  void insert_symbol_references(long long artifact_id, const SymbolReferenceSet& symbols, const char* category);
+  // Rows written by a single INSERT statement, the remainder goes through create_symbol_reference().
+  static constexpr size_t symbol_references_per_insert = 64;
+
+  void insert_symbol_references(long long artifact_id, const SymbolReferenceSet& symbols, SymbolCategory category, long long member_id = -1);
 
   void insert_symbol_references(long long artifact_id, const ArtifactSymbols& symbols);
 
+  void insert_symbol_references(long long artifact_id, long long member_id, const ArtifactSymbols& symbols);
+
+  long long create_archive_member(long long artifact_id, const std::string& name);
+
+  void delete_symbol_references(long long artifact_id);
+
+  void set_artifact_identity(long long artifact_id, const FileIdentity& identity);
+
+  void delete_artifact_identity(long long artifact_id);
+
   long long count_dependencies();
 
   void create_dependency(long long dependee_id, long long dependency_id);
 
-  SQLite::Statement build_get_depend_stm(const std::string& select_field,
-                                         const std::string& match_field,
-                                         const std::vector<std::string>& included_types,
-                                         const std::vector<std::string>& excluded_types);
+  SQLite::Statement& build_get_depend_stm(const std::string& select_field,
+                                          const std::string& match_field,
+                                          const std::vector<std::string>& included_types,
+                                          const std::vector<std::string>& excluded_types);
 
   std::vector<long long> dependencies(long long dependee_id);
 
@@ -158,10 +271,48 @@ public:
 
   void set_timestamp(const std::string& name, const std::chrono::high_resolution_clock::time_point& time);
 
+  // Position reached by an interrupted task, -1 if it completed or never ran.
+  long long get_progress(const std::string& name);
+
+  void set_progress(const std::string& name, long long position);
+
+  void clear_progress(const std::string& name);
+
+  // The task transaction is committed every `steps` steps or `period`, whichever comes first.
+  // Not set for dry runs, the whole task is then rolled back.
+  void set_checkpoint_interval(size_t steps, std::chrono::seconds period);
+
+  bool checkpoints_enabled() const { return mCheckpointSteps > 0 || mCheckpointPeriod.count() > 0; }
+
+  // Counts the steps done, true once a checkpoint is due.
+  bool checkpoint_due(size_t steps = 1);
+
+  // Commits the task transaction and begins the next one. Must not be called within a savepoint.
+  void checkpoint();
+
+  size_t checkpoints() const { return mCheckpoints; }
+
   static long long get_id(SQLite::Statement& stm);
   static std::vector<long long> get_ids(SQLite::Statement& stm);
 
+  // Binds the ids as a JSON array, for statements testing membership with
+  // "in (select value from json_each(?))". Unlike in_expr(), the text of the statement
+  // does not depend on the ids: it is prepared once and no literal is parsed per id.
+  static void bind_ids(SQLite::Statement& stm, int index, const std::vector<long long>& ids);
+
   static std::string get_string(SQLite::Statement& stm);
 };
 
+// Drops the non-unique indexes of some tables while they are filled and creates them again when
+// destroyed: a single CREATE INDEX sorts the rows once instead of updating a B-tree for each row.
+class BulkLoad : boost::noncopyable {
+private:
+  Database2& mDb;
+  std::vector<std::string> mIndexes;
+
+public:
+  BulkLoad(Database2& db, const std::vector<std::string>& tables);
+  ~BulkLoad();
+};
+
 #endif /* DATABASE2_HXX */
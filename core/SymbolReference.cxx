@@ -22,3 +22,10 @@ bool SymbolReferenceCmp::operator()(const SymbolReference& lhs, const SymbolRefe
     return false;
   }
 }
+
+bool operator==(const SymbolReference& lhs, const SymbolReference& rhs) {
+  return lhs.type == rhs.type
+      && lhs.address == rhs.address
+      && lhs.size == rhs.size
+      && lhs.name == rhs.name;
+}
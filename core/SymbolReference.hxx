@@ -1,17 +1,17 @@
 #ifndef SYMBOL_REFERENCE_HXX
 #define SYMBOL_REFERENCE_HXX
 
-#include <string>
-#include <utility>
+#include <string_view>
 
+// The name is not owned, it is stored in the arena of the SymbolReferenceSet holding the reference.
 class SymbolReference
 {
 public:
-  SymbolReference(std::string name, char type, long long address, long long size)
-    : name(std::move(name)), type(type), address(address), size(size)
+  SymbolReference(std::string_view name, char type, long long address, long long size)
+    : name(name), type(type), address(address), size(size)
   {}
 
-  std::string name;
+  std::string_view name;
   char type;
   long long address, size;
 };
@@ -20,4 +20,6 @@ struct SymbolReferenceCmp {
   bool operator()(const SymbolReference& lhs, const SymbolReference& rhs) const;
 };
 
+bool operator==(const SymbolReference& lhs, const SymbolReference& rhs);
+
 #endif /* SYMBOL_REFERENCE_HXX */
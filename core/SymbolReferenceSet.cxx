@@ -1,6 +1,71 @@
 #include "SymbolReferenceSet.hxx"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+SymbolReferenceSet::SymbolReferenceSet() = default;
+
+// The moved-from set is left empty, its next emplace() creates a new arena.
+SymbolReferenceSet::SymbolReferenceSet(SymbolReferenceSet&& other) noexcept
+  : mArena(std::move(other.mArena))
+  , mSymbols(std::move(other.mSymbols))
+  , mNormalized(other.mNormalized)
+{
+  other.mSymbols.clear();
+  other.mNormalized = true;
+}
+
+SymbolReferenceSet& SymbolReferenceSet::operator=(SymbolReferenceSet&& other) noexcept
+{
+  if (this != &other) {
+    mSymbols = std::move(other.mSymbols);
+    mArena = std::move(other.mArena);
+    mNormalized = other.mNormalized;
+
+    other.mSymbols.clear();
+    other.mNormalized = true;
+  }
+
+  return *this;
+}
+
+SymbolReferenceSet::~SymbolReferenceSet() = default;
+
+void SymbolReferenceSet::emplace(std::string_view name, char type, long long address, long long size)
+{
+  if (!mArena)
+    mArena = std::make_unique<std::pmr::monotonic_buffer_resource>();
+
+  char* copy = static_cast<char*>(mArena->allocate(name.size(), 1));
+  std::memcpy(copy, name.data(), name.size());
+
+  mSymbols.emplace_back(std::string_view(copy, name.size()), type, address, size);
+  mNormalized = false;
+}
+
+void SymbolReferenceSet::normalize() const
+{
+  if (mNormalized)
+    return;
+
+  std::sort(mSymbols.begin(), mSymbols.end(), SymbolReferenceCmp());
+  mSymbols.erase(std::unique(mSymbols.begin(), mSymbols.end()), mSymbols.end());
+  mNormalized = true;
+}
+
 void substract_set(SymbolReferenceSet& to, const SymbolReferenceSet& from) {
-  for(const SymbolReference& s : from)
-    to.erase(s);
+  to.normalize();
+  from.normalize();
+
+  std::vector<SymbolReference> difference;
+  difference.reserve(to.mSymbols.size());
+
+  std::set_difference(to.mSymbols.cbegin(), to.mSymbols.cend(),
+                      from.mSymbols.cbegin(), from.mSymbols.cend(),
+                      std::back_inserter(difference),
+                      SymbolReferenceCmp());
+
+  // Names remain in the arena of "to".
+  to.mSymbols = std::move(difference);
 }
@@ -2,10 +2,50 @@
 #define SYMBOL_REFERENCE_SET_HXX
 
 #include "SymbolReference.hxx"
-#include <set>
 
-using SymbolReferenceSet = std::set<SymbolReference, SymbolReferenceCmp>;
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
 
+// Flat set of symbol references.
+// Names are copied into a monotonic arena owned by the set, created by the first insertion and moved
+// along with the references. These are appended to a vector which is only sorted and deduplicated
+// when the set is first read after an insertion.
+class SymbolReferenceSet
+{
+public:
+  using value_type = SymbolReference;
+  using const_iterator = std::vector<SymbolReference>::const_iterator;
+  using iterator = const_iterator;
+
+private:
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> mArena;
+  mutable std::vector<SymbolReference> mSymbols;
+  mutable bool mNormalized = true;
+
+  void normalize() const;
+
+public:
+  SymbolReferenceSet();
+  SymbolReferenceSet(SymbolReferenceSet&&) noexcept;
+  SymbolReferenceSet& operator=(SymbolReferenceSet&&) noexcept;
+  ~SymbolReferenceSet();
+
+  void emplace(std::string_view name, char type, long long address, long long size);
+
+  void reserve(size_t count) { mSymbols.reserve(count); }
+
+  const_iterator begin() const { normalize(); return mSymbols.cbegin(); }
+  const_iterator end() const { normalize(); return mSymbols.cend(); }
+
+  size_t size() const { normalize(); return mSymbols.size(); }
+  bool empty() const { return mSymbols.empty(); }
+
+  friend void substract_set(SymbolReferenceSet& to, const SymbolReferenceSet& from);
+};
+
+// Linear merge, both sets being sorted.
 void substract_set(SymbolReferenceSet& to, const SymbolReferenceSet& from);
 
 #endif /* SYMBOL_REFERENCE_SET_HXX */
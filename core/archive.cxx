@@ -0,0 +1,199 @@
+#include "archive.hxx"
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+#include "mapped-file.hxx"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char regular_magic[] = "!<arch>\n";
+constexpr char thin_magic[] = "!<thin>\n";
+constexpr size_t magic_size = sizeof(regular_magic) - 1;
+
+struct Header {
+  char name[16];
+  char date[12];
+  char uid[6];
+  char gid[6];
+  char mode[8];
+  char size[10];
+  char fmag[2];
+};
+
+static_assert(sizeof(Header) == 60, "Unexpected ar header size");
+
+std::string_view rtrim_spaces(std::string_view str) {
+  const size_t last = str.find_last_not_of(' ');
+  return last == std::string_view::npos ? std::string_view() : str.substr(0, last + 1);
+}
+
+size_t parse_decimal(std::string_view str) {
+  size_t value = 0UL;
+  for(const char c : rtrim_spaces(str)) {
+    if (c < '0' || c > '9')
+      throw std::runtime_error("Invalid archive member header");
+    value = value * 10 + static_cast<size_t>(c - '0');
+  }
+  return value;
+}
+
+template<typename T>
+T load_big_endian(const char* data) {
+  T value = 0;
+  for(size_t i = 0; i < sizeof(T); ++i)
+    value = static_cast<T>((value << 8) | static_cast<unsigned char>(data[i]));
+  return value;
+}
+
+// Parses the GNU symbol index ("/" or "/SYM64/" member): a count, the header offsets
+// of the defining members, then as many NUL-terminated symbol names.
+template<typename T>
+void parse_index(const char* data, size_t size,
+                 const std::vector<size_t>& member_offsets,
+                 std::unordered_map<std::string_view, size_t>& index) {
+  if (size < sizeof(T))
+    throw std::runtime_error("Truncated archive symbol index");
+
+  const size_t count = load_big_endian<T>(data);
+  if (count > (size - sizeof(T)) / sizeof(T))
+    throw std::runtime_error("Truncated archive symbol index");
+
+  const char* names = data + sizeof(T) * (count + 1);
+  const char* end = data + size;
+
+  for(size_t i = 0; i < count && names < end; ++i) {
+    const size_t offset = load_big_endian<T>(data + sizeof(T) * (i + 1));
+
+    const char* name_end = static_cast<const char*>(std::memchr(names, 0, end - names));
+    if (!name_end)
+      name_end = end;
+
+    auto member = std::lower_bound(member_offsets.begin(), member_offsets.end(), offset);
+    if (member != member_offsets.end() && *member == offset)
+      index.emplace(std::string_view(names, name_end - names), member - member_offsets.begin());
+
+    names = name_end + 1;
+  }
+}
+
+} // anonymous namespace
+
+Archive::Archive(const std::string& path)
+  : Archive(std::make_unique<MappedFile>(path), path)
+{}
+
+Archive::Archive(std::unique_ptr<MappedFile> file, const std::string& path)
+  : mFile(std::move(file))
+  , mThin(false)
+{
+  const char* data = mFile->data();
+  const size_t size = mFile->size();
+
+  if (!is_archive(data, size))
+    throw std::runtime_error("Not an archive");
+
+  mThin = std::memcmp(data, thin_magic, magic_size) == 0;
+
+  const fs::path directory = fs::path(path).parent_path();
+
+  std::string_view long_names;
+
+  size_t offset = magic_size;
+  while (offset + sizeof(Header) <= size) {
+    Header header;
+    std::memcpy(&header, data + offset, sizeof(Header));
+
+    if (header.fmag[0] != '`' || header.fmag[1] != '\n')
+      throw std::runtime_error("Invalid archive member header");
+
+    const size_t header_offset = offset;
+    const std::string_view raw_name = rtrim_spaces(std::string_view(header.name, sizeof(header.name)));
+    size_t member_size = parse_decimal(std::string_view(header.size, sizeof(header.size)));
+    offset += sizeof(Header);
+
+    // Only the index and the long names table are stored in a thin archive.
+    const bool special = raw_name == "/" || raw_name == "/SYM64/" || raw_name == "//";
+    const bool stored = !mThin || special;
+
+    if (stored && member_size > size - offset)
+      throw std::runtime_error("Truncated archive member");
+
+    const char* member_data = data + offset;
+
+    if (raw_name == "/" || raw_name == "/SYM64/") {
+      mIndexData = member_data;
+      mIndexSize = member_size;
+      mIndex64 = raw_name == "/SYM64/";
+    } else if (raw_name == "//") {
+      long_names = std::string_view(member_data, member_size);
+    } else {
+      std::string name;
+      if (raw_name.size() > 1 && raw_name[0] == '/') {
+        // GNU long name: offset in the "//" member, terminated by "/\n".
+        const size_t name_offset = parse_decimal(raw_name.substr(1));
+        if (name_offset >= long_names.size())
+          throw std::runtime_error("Invalid archive long name");
+        name = std::string(long_names.substr(name_offset, long_names.find('\n', name_offset) - name_offset));
+        if (!name.empty() && name.back() == '/')
+          name.pop_back();
+      } else if (raw_name.substr(0, 3) == "#1/") {
+        // BSD long name, stored in front of the member data.
+        const size_t name_size = parse_decimal(raw_name.substr(3));
+        if (name_size > member_size)
+          throw std::runtime_error("Invalid archive long name");
+        name = std::string(member_data, strnlen(member_data, name_size));
+        member_data += name_size;
+        member_size -= name_size;
+      } else {
+        name = std::string(raw_name);
+        if (!name.empty() && name.back() == '/')
+          name.pop_back();
+      }
+
+      mMemberOffsets.push_back(header_offset);
+
+      if (mThin) {
+        const fs::path member_path = fs::path(name).is_absolute() ? fs::path(name) : directory / name;
+        mExternalFiles.emplace_back(std::make_unique<MappedFile>(member_path.string()));
+        mMembers.push_back({name, mExternalFiles.back()->data(), mExternalFiles.back()->size()});
+      } else {
+        mMembers.push_back({name, member_data, member_size});
+      }
+    }
+
+    if (stored) {
+      offset += member_size;
+      offset += offset % 2; // Members are 2-bytes aligned.
+    }
+  }
+}
+
+Archive::~Archive() = default;
+
+bool Archive::is_archive(const char* data, size_t size)
+{
+  return size >= magic_size
+      && (std::memcmp(data, regular_magic, magic_size) == 0 || std::memcmp(data, thin_magic, magic_size) == 0);
+}
+
+const Archive::Member* Archive::member_defining(std::string_view symbol) const
+{
+  std::call_once(mIndexParsed, [this]{
+    if (!mIndexData)
+      return;
+
+    if (mIndex64)
+      parse_index<uint64_t>(mIndexData, mIndexSize, mMemberOffsets, mIndex);
+    else
+      parse_index<uint32_t>(mIndexData, mIndexSize, mMemberOffsets, mIndex);
+  });
+
+  auto it = mIndex.find(symbol);
+  return it == mIndex.end() ? nullptr : &mMembers[it->second];
+}
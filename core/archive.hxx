@@ -0,0 +1,60 @@
+#ifndef ARCHIVE_HXX
+#define ARCHIVE_HXX
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/core/noncopyable.hpp>
+
+class MappedFile;
+
+// Reader for ar(1) archives, regular and thin.
+// Members of thin archives are mapped from their own files, resolved relatively to the archive.
+class Archive : boost::noncopyable {
+public:
+  struct Member {
+    std::string name;
+    const char* data;
+    size_t size;
+  };
+
+private:
+  std::unique_ptr<MappedFile> mFile;
+  std::vector<std::unique_ptr<MappedFile>> mExternalFiles;
+  bool mThin;
+  std::vector<Member> mMembers;
+  // Offset of the header of each member, in increasing order.
+  std::vector<size_t> mMemberOffsets;
+
+  // GNU symbol index, parsed on the first lookup: extracting symbols reads every member anyway.
+  const char* mIndexData = nullptr;
+  size_t mIndexSize = 0UL;
+  bool mIndex64 = false;
+  mutable std::once_flag mIndexParsed;
+  // Maps a defined symbol to the position of its member in mMembers.
+  mutable std::unordered_map<std::string_view, size_t> mIndex;
+
+public:
+  explicit Archive(const std::string& path);
+  Archive(std::unique_ptr<MappedFile> file, const std::string& path);
+  ~Archive();
+
+  static bool is_archive(const char* data, size_t size);
+
+  bool thin() const { return mThin; }
+
+  const std::vector<Member>& members() const { return mMembers; }
+
+  bool has_index() const { return mIndexData != nullptr; }
+
+  // Looks up the archive symbol index, returns nullptr if no member defines that symbol.
+  // The index is parsed by the first call.
+  const Member* member_defining(std::string_view symbol) const;
+};
+
+#endif // ARCHIVE_HXX
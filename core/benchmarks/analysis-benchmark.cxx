@@ -0,0 +1,206 @@
+// Times the symbol analysis queries against a synthetic database:
+//   analysis-benchmark [libraries] [symbols per library] [bulk|query|lowmem]
+// Libraries export symbols used by the next ones, executables link a few of them.
+// The plan of the queries built here is printed before their timing.
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <SQLiteCpp/Transaction.h>
+
+#include "Database2.hxx"
+#include "ArtifactSymbols.hxx"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Queries of cli/tasks/analyse-task.cxx, resolve_symbols() is timed through Database2.
+const std::string unresolved_symbols_query = R"(
+select symbol_id
+from symbol_references
+inner join dependencies on symbol_references.artifact_id = dependencies.dependency_id
+where symbol_references.category = )" + std::to_string(external_symbol) + R"(
+and dependencies.dependee_id = ?
+and symbol_references.symbol_id in (select value from json_each(?)))";
+
+const std::string useful_dependencies_query = R"(
+select distinct symbol_references.artifact_id
+from symbol_references
+where symbol_references.artifact_id in (select value from json_each(?))
+and symbol_references.category = )" + std::to_string(external_symbol) + R"(
+and +symbol_references.symbol_id in (select value from json_each(?)))";
+
+const char* duplicated_symbols_query = R"(
+select symbols.id, symbols.name as name, symbols.dname as dname, count(*) as occurences, sum(symbol_references.size) as total_size
+from symbols
+inner join symbol_references on symbols.id = symbol_references.symbol_id
+inner join artifacts on artifacts.id = symbol_references.artifact_id
+where symbol_references.size > 0
+and artifacts.type in ("shared", "executable")
+group by symbols.id
+having occurences > 1
+order by total_size desc, name asc;
+)";
+
+std::string symbol_name(size_t library, size_t symbol)
+{
+  return "_ZN3lib" + std::to_string(library) + "8functionEi" + std::to_string(symbol);
+}
+
+void populate(Database2& db, const size_t libraries, const size_t symbols)
+{
+  SQLite::Transaction transaction(db.database());
+
+  const size_t executables = std::max<size_t>(libraries / 4, 1);
+  const size_t exported = symbols * 2 / 3;
+
+  for(size_t l = 0; l < libraries; ++l) {
+    db.create_artifact("lib" + std::to_string(l) + ".so", "shared");
+    const long long id = db.last_id();
+
+    ArtifactSymbols artifact;
+    for(size_t s = 0; s < exported; ++s)
+      artifact.external.emplace(symbol_name(l, s), 'T', 0x1000 + s * 16, 16 + s % 64);
+    for(size_t s = 0; s < symbols / 6; ++s)
+      artifact.internal.emplace("_ZL6helperi" + std::to_string(s % 500), 't', 0x100000 + s * 16, 8 + s % 32);
+
+    // Uses the four previous libraries, links one more it does not use.
+    for(size_t d = 1; d <= 5 && d <= l; ++d) {
+      db.create_dependency(id, id - d);
+      if (d == 5)
+        break;
+      for(size_t s = 0; s < symbols / 24; ++s)
+        artifact.undefined.emplace(symbol_name(l - d, (s * 7 + l) % exported), 'U', -1, 0);
+    }
+    artifact.undefined.emplace("missing" + std::to_string(l), 'U', -1, 0);
+
+    db.insert_symbol_references(id, artifact);
+  }
+
+  for(size_t e = 0; e < executables; ++e) {
+    db.create_artifact("app" + std::to_string(e), "executable");
+    const long long id = db.last_id();
+
+    ArtifactSymbols artifact;
+    for(size_t d = 0; d < 8 && d < libraries; ++d) {
+      const size_t l = (e * 13 + d * 7) % libraries;
+      db.create_dependency(id, static_cast<long long>(l + 1));
+      for(size_t s = 0; s < symbols / 16; ++s)
+        artifact.undefined.emplace(symbol_name(l, (s * 11 + e) % exported), 'U', -1, 0);
+    }
+    artifact.external.emplace("main", 'T', 0x1000, 128);
+
+    db.insert_symbol_references(id, artifact);
+  }
+
+  transaction.commit();
+  db.optimize();
+}
+
+void print_plan(Database2& db, const std::string& query)
+{
+  SQLite::Statement stm = db.statement("explain query plan " + query);
+  for(int i = 1; i <= stm.getBindParameterCount(); ++i)
+    stm.bind(i, 1LL);
+  while (stm.executeStep())
+    std::cout << "    " << stm.getColumn(3).getString() << "\n";
+}
+
+void measure(const char* label, size_t runs, const std::function<void()>& f)
+{
+  const auto start = std::chrono::high_resolution_clock::now();
+  f();
+  const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+  std::cout << std::left << std::setw(22) << label
+            << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << elapsed.count() << " ms"
+            << std::setw(12) << elapsed.count() / runs << " ms/run" << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  const size_t libraries = argc > 1 ? std::stoul(argv[1]) : 200;
+  const size_t symbols = argc > 2 ? std::stoul(argv[2]) : 3000;
+  const std::string profile = argc > 3 ? argv[3] : "query";
+
+  const fs::path path = fs::temp_directory_path() / "analysis-benchmark.db";
+  fs::remove(path);
+
+  {
+    Database2 db(path.string());
+    db.set_storage_profile(profile == "bulk" ? StorageProfile::bulk : profile == "lowmem" ? StorageProfile::lowmem : StorageProfile::query);
+    populate(db, libraries, symbols);
+
+    auto pages = db.statement("select page_count * page_size from pragma_page_count, pragma_page_size");
+
+    std::cout << db.count_artifacts() << " artifacts, "
+              << db.count_symbols() << " symbols, "
+              << db.count_symbol_references() << " references, "
+              << Database2::get_id(pages) / 1024 << " KiB" << std::endl;
+
+    std::vector<long long> artifacts(static_cast<size_t>(db.count_artifacts()));
+    std::iota(artifacts.begin(), artifacts.end(), 1LL);
+
+    std::vector<std::vector<long long>> undefined(artifacts.size()), dependencies(artifacts.size());
+
+    std::cout << "undefined symbols\n";
+    print_plan(db, "select symbol_id from symbol_references where artifact_id = ? and category = " + std::to_string(undefined_symbol));
+    measure("undefined", artifacts.size(), [&]{
+      for(size_t i = 0; i < artifacts.size(); ++i) {
+        undefined[i] = db.undefined_symbols(artifacts[i]);
+        dependencies[i] = db.dependencies(artifacts[i]);
+      }
+    });
+
+    std::cout << "unresolved symbols\n";
+    print_plan(db, unresolved_symbols_query);
+    measure("unresolved", artifacts.size(), [&]{
+      SQLite::Statement stm = db.statement(unresolved_symbols_query);
+      for(size_t i = 0; i < artifacts.size(); ++i) {
+        stm.bind(1, artifacts[i]);
+        Database2::bind_ids(stm, 2, undefined[i]);
+        Database2::get_ids(stm);
+      }
+    });
+
+    std::cout << "resolve symbols\n";
+    measure("resolve", artifacts.size(), [&]{
+      for(size_t i = 0; i < artifacts.size(); ++i)
+        db.resolve_symbols(undefined[i]);
+    });
+
+    std::cout << "useful dependencies\n";
+    print_plan(db, useful_dependencies_query);
+    measure("useful-dependencies", artifacts.size(), [&]{
+      SQLite::Statement stm = db.statement(useful_dependencies_query);
+      for(size_t i = 0; i < artifacts.size(); ++i) {
+        Database2::bind_ids(stm, 1, dependencies[i]);
+        Database2::bind_ids(stm, 2, undefined[i]);
+        Database2::get_ids(stm);
+      }
+    });
+
+    std::cout << "duplicated symbols\n";
+    print_plan(db, duplicated_symbols_query);
+    measure("duplicated", 1, [&]{
+      SQLite::Statement stm = db.statement(duplicated_symbols_query);
+      while (stm.executeStep());
+    });
+  }
+
+  fs::remove(path);
+  fs::remove(path.string() + "-wal");
+  fs::remove(path.string() + "-shm");
+}
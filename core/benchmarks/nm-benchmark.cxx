@@ -0,0 +1,112 @@
+// Measures parse_nm_output() throughput on a captured "nm -S" dump:
+//   nm -S --defined-only big-library.so > dump.txt && nm-benchmark dump.txt
+// Without argument, a synthetic dump is generated.
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "nm.hxx"
+
+namespace {
+
+// parse_nm_output() as it was before being made block-buffered, kept as a reference.
+void legacy_parse_nm_output(std::istream& stream, SymbolReferenceSet& symbols)
+{
+  std::string line;
+  while (stream && std::getline(stream, line) && !line.empty()) {
+    long long address = -1;
+    long long sz = 0;
+    size_t offset = 17;
+
+    if (line[offset] >= '0' && line[offset] <= '9') {
+      const std::string addr_str(line, 0, 16);
+      address = std::stoll(addr_str, nullptr, 16);
+
+      const std::string size_str(line, 17, 16);
+      sz = std::stoll(size_str, nullptr, 16);
+      offset = 34;
+    }
+
+    if (line[offset + 2] == '.'
+        || memrchr(&(line[offset + 2]), '.', line.length() - offset - 2) != NULL
+        || strncmp(&(line[offset + 2]), "__gmon_start__", sizeof("__gmon_start__")) == 0
+        || strncmp(&(line[offset + 2]), "_ITM_", sizeof("_ITM_")) == 0)
+      continue;
+
+    symbols.emplace(std::string(line, offset + 2), line[offset], address, sz);
+  }
+}
+
+std::string synthetic_dump(size_t count)
+{
+  std::ostringstream ss;
+  ss << std::hex << std::setfill('0');
+  for(size_t i = 0; i < count; ++i) {
+    if (i % 4 == 0) {
+      ss << "                 U _ZN9namespace14undefined_call" << std::dec << i << std::hex << "Ev\n";
+    } else {
+      ss << std::setw(16) << 0x1000 + i * 16 << ' ' << std::setw(16) << (i % 512) << ' '
+         << (i % 3 ? 'T' : 'D') << " _ZN9namespace5Class" << std::dec << i << std::hex << "13some_functionERKSt6vectorIiSaIiEE\n";
+    }
+  }
+  return ss.str();
+}
+
+template<typename F>
+void run(const char* label, const std::string& dump, size_t iterations, F parse)
+{
+  size_t count = 0UL;
+
+  const auto start = std::chrono::high_resolution_clock::now();
+  for(size_t i = 0; i < iterations; ++i) {
+    SymbolReferenceSet symbols;
+    parse(dump, symbols);
+    count = symbols.size();
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+  const double mb = double(dump.size()) * iterations / (1024 * 1024);
+  std::cout << std::left << std::setw(16) << label
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << mb / elapsed.count() << " MB/s"
+            << " (" << count << " symbols)" << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  std::string dump;
+
+  if (argc > 1) {
+    std::ifstream in(argv[1]);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    dump = ss.str();
+  } else {
+    dump = synthetic_dump(500000);
+  }
+
+  const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 5;
+
+  std::cout << "Dump: " << dump.size() / (1024 * 1024) << " MB, " << iterations << " iterations" << std::endl;
+
+  run("getline", dump, iterations, [](const std::string& data, SymbolReferenceSet& symbols) {
+    std::istringstream in(data);
+    legacy_parse_nm_output(in, symbols);
+  });
+
+  run("stream", dump, iterations, [](const std::string& data, SymbolReferenceSet& symbols) {
+    std::istringstream in(data);
+    parse_nm_output(in, symbols);
+  });
+
+  run("string_view", dump, iterations, [](const std::string& data, SymbolReferenceSet& symbols) {
+    parse_nm_output(std::string_view(data), symbols);
+  });
+}
@@ -0,0 +1,123 @@
+// Measures how fast symbol references are written to the database:
+//   symbols-benchmark [artifacts] [references per artifact]
+// Synthetic artifacts reference symbols from a shared pool, as libraries of a same project do.
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <SQLiteCpp/Transaction.h>
+
+#include "Database2.hxx"
+#include "ArtifactSymbols.hxx"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// insert_symbol_references() as it was before the symbol dictionary, kept as a reference.
+void legacy_insert_symbol_references(Database2& db, long long artifact_id, const SymbolReferenceSet& symbols, SymbolCategory category)
+{
+  for(const SymbolReference& symbol : symbols) {
+    const std::string symbol_name(symbol.name);
+
+    long long symbol_id = db.symbol_id_by_name(symbol_name);
+    if (symbol_id == -1) {
+      db.create_symbol(symbol_name);
+      symbol_id = db.last_id();
+    }
+
+    db.create_symbol_reference(artifact_id, symbol_id, category, symbol.type, symbol.size);
+  }
+}
+
+std::vector<ArtifactSymbols> synthetic_artifacts(size_t artifacts, size_t references)
+{
+  const size_t pool = artifacts * references / 4;
+
+  std::vector<ArtifactSymbols> out(artifacts);
+  for(size_t a = 0; a < artifacts; ++a) {
+    for(size_t r = 0; r < references; ++r) {
+      const size_t s = (a * 7919 + r * 104729) % pool;
+      const std::string name = "_ZN9namespace5Class" + std::to_string(s) + "13some_functionEv";
+
+      if (r % 3 == 0)
+        out[a].undefined.emplace(name, 'U', -1, 0);
+      else
+        out[a].external.emplace(name, 'T', 0x1000 + r * 16, r % 512);
+    }
+  }
+
+  return out;
+}
+
+template<typename F>
+void run(const char* label, const std::vector<ArtifactSymbols>& artifacts, F insert, bool bulk = false)
+{
+  const fs::path path = fs::temp_directory_path() / "symbols-benchmark.db";
+  fs::remove(path);
+
+  size_t count = 0UL;
+  std::chrono::duration<double> elapsed;
+
+  {
+    Database2 db(path.string());
+    SQLite::Transaction transaction(db.database());
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    {
+      std::optional<BulkLoad> load;
+      if (bulk)
+        load.emplace(db, std::vector<std::string>{"symbols", "symbol_references"});
+
+      for(size_t a = 0; a < artifacts.size(); ++a) {
+        db.create_artifact("artifact" + std::to_string(a), "shared");
+        insert(db, db.last_id(), artifacts[a]);
+      }
+    }
+    transaction.commit();
+    elapsed = std::chrono::high_resolution_clock::now() - start;
+
+    count = db.count_symbol_references();
+  }
+
+  fs::remove(path);
+  fs::remove(path.string() + "-wal");
+  fs::remove(path.string() + "-shm");
+
+  std::cout << std::left << std::setw(16) << label
+            << std::right << std::fixed << std::setprecision(0)
+            << std::setw(12) << count / elapsed.count() << " references/s"
+            << " (" << count << " references)" << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+  const size_t artifacts = argc > 1 ? std::stoul(argv[1]) : 200;
+  const size_t references = argc > 2 ? std::stoul(argv[2]) : 5000;
+
+  const std::vector<ArtifactSymbols> data = synthetic_artifacts(artifacts, references);
+
+  std::cout << artifacts << " artifacts, " << references << " references each" << std::endl;
+
+  run("select+insert", data, [](Database2& db, long long artifact_id, const ArtifactSymbols& symbols) {
+    legacy_insert_symbol_references(db, artifact_id, symbols.undefined, undefined_symbol);
+    legacy_insert_symbol_references(db, artifact_id, symbols.external, external_symbol);
+    legacy_insert_symbol_references(db, artifact_id, symbols.internal, internal_symbol);
+  });
+
+  run("dictionary", data, [](Database2& db, long long artifact_id, const ArtifactSymbols& symbols) {
+    db.insert_symbol_references(artifact_id, symbols);
+  });
+
+  run("bulk", data, [](Database2& db, long long artifact_id, const ArtifactSymbols& symbols) {
+    db.insert_symbol_references(artifact_id, symbols);
+  }, true);
+}
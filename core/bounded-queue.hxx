@@ -0,0 +1,81 @@
+#ifndef BOUNDEDQUEUE_HXX
+#define BOUNDEDQUEUE_HXX
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Multiple producers, one or several consumers. Producers block while the queue is full,
+// consumers block while it is empty. Both report how long they waited.
+template<typename T>
+class BoundedQueue {
+private:
+  using clock = std::chrono::steady_clock;
+
+  const size_t mCapacity;
+  std::deque<T> mItems;
+  bool mClosed = false;
+  std::mutex mMutex;
+  std::condition_variable mNotFull, mNotEmpty;
+
+public:
+  explicit BoundedQueue(size_t capacity) : mCapacity(capacity > 0 ? capacity : 1) {}
+
+  size_t capacity() const { return mCapacity; }
+
+  // Returns the time spent waiting for room. Items pushed once closed are dropped.
+  clock::duration push(T&& item) {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    const clock::time_point start = clock::now();
+    mNotFull.wait(lock, [this]{ return mClosed || mItems.size() < mCapacity; });
+    const clock::duration waited = clock::now() - start;
+
+    if (!mClosed) {
+      mItems.emplace_back(std::move(item));
+      mNotEmpty.notify_one();
+    }
+
+    return waited;
+  }
+
+  // Moves up to max_items into batch, waiting for at least one.
+  // Returns the queue depth seen when woken up, 0 once closed and drained.
+  size_t pop(std::vector<T>& batch, size_t max_items, clock::duration& waited) {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    const clock::time_point start = clock::now();
+    mNotEmpty.wait(lock, [this]{ return mClosed || !mItems.empty(); });
+    waited = clock::now() - start;
+
+    const size_t depth = mItems.size();
+    while (!mItems.empty() && batch.size() < max_items) {
+      batch.emplace_back(std::move(mItems.front()));
+      mItems.pop_front();
+    }
+
+    mNotFull.notify_all();
+    return depth;
+  }
+
+  // Wakes everybody up: the consumer drains what is left, producers stop blocking.
+  void close() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClosed = true;
+    mNotFull.notify_all();
+    mNotEmpty.notify_all();
+  }
+
+  // Drops the pending items, used when the consumer gives up.
+  void abort() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClosed = true;
+    mItems.clear();
+    mNotFull.notify_all();
+    mNotEmpty.notify_all();
+  }
+};
+
+#endif // BOUNDEDQUEUE_HXX
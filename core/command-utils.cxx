@@ -1,43 +1,57 @@
 #include "command-utils.hxx"
 
-#include <sstream>
 #include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <thread>
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
 #include <shellwords/shellwords.hxx>
 #include <instrmt/instrmt.hxx>
 
+#include "bounded-queue.hxx"
 #include "utils.hxx"
+#include "json-reader.hxx"
 #include "Database2.hxx"
 
 namespace fs = std::filesystem;
-namespace pt = boost::property_tree;
 
 namespace {
 
-void parse_cc_args(shellwords::shell_splitter& splitter, CompilationCommand& command) {
-  while(splitter.read_next()) {
-    const std::string& arg = splitter.arg();
+void parse_cc_args(const std::vector<std::string>& argv, CompilationCommand& command) {
+  for(size_t i = 0; i < argv.size(); ++i) {
+    const std::string& arg = argv[i];
     if (starts_with(arg, "-o")) {
       if (arg.size() > 2) {
         command.output = arg.substr(2);
       } else {
-        if (splitter.read_next())
-          command.output = splitter.arg();
+        if (i + 1 < argv.size())
+          command.output = argv[++i];
       }
     }
   }
 }
 
-void parse_ar_args(shellwords::shell_splitter& splitter, CompilationCommand& command) {
-  while(splitter.read_next()) {
-    const std::string& arg = splitter.arg();
+void parse_ar_args(const std::vector<std::string>& argv, CompilationCommand& command) {
+  for(const std::string& arg : argv) {
     if (ends_with(arg, ".a") && command.output.empty())
       command.output = arg;
   }
 }
 
+void append_uint32(std::string& out, uint32_t value) {
+  for(int shift = 0; shift < 32; shift += 8)
+    out += static_cast<char>((value >> shift) & 0xFF);
+}
+
+uint32_t read_uint32(std::string_view in) {
+  uint32_t value = 0;
+  for(int i = 3; i >= 0; --i)
+    value = (value << 8) | static_cast<unsigned char>(in[i]);
+  return value;
+}
+
 const std::vector<std::string> gcc_commands = {"cc", "c++", "gcc", "g++"};
 
 void clear(CompilationCommand& cmd)
@@ -46,6 +60,7 @@ void clear(CompilationCommand& cmd)
   cmd.directory.clear();
   cmd.executable.clear();
   cmd.args.clear();
+  cmd.argv.clear();
   cmd.output.clear();
   cmd.output_type.clear();
 }
@@ -62,6 +77,47 @@ bool is_ar(const std::string& command) {
   return ends_with(command, "ar");
 }
 
+std::string encode_argv(const std::vector<std::string>& argv) {
+  size_t size = 0;
+  for(const std::string& arg : argv)
+    size += 4 + arg.size();
+
+  std::string encoded;
+  encoded.reserve(size);
+
+  for(const std::string& arg : argv) {
+    append_uint32(encoded, static_cast<uint32_t>(arg.size()));
+    encoded += arg;
+  }
+
+  return encoded;
+}
+
+void ArgvView::iterator::next() {
+  if (mRest.empty()) {
+    mEnd = true;
+    mArg = {};
+    return;
+  }
+
+  if (mRest.size() < 4)
+    throw std::runtime_error("Invalid encoded arguments: truncated length");
+
+  const uint32_t length = read_uint32(mRest);
+  mRest.remove_prefix(4);
+
+  if (mRest.size() < length)
+    throw std::runtime_error("Invalid encoded arguments: truncated argument");
+
+  mArg = mRest.substr(0, length);
+  mRest.remove_prefix(length);
+}
+
+std::vector<std::string_view> decode_argv(std::string_view encoded) {
+  const ArgvView view(encoded);
+  return {view.begin(), view.end()};
+}
+
 void parse_command(const std::string& line, CompilationCommand& command, const int options)
 {
   shellwords::shell_splitter splitter(line.begin(), line.end());
@@ -76,14 +132,21 @@ void parse_command(const std::string& line, CompilationCommand& command, const i
 
   command.args = std::string(splitter.suffix(), line.end());
 
+  // Split once here, the arguments are stored with the command and never split again.
+  std::vector<std::string> argv;
+  while (splitter.read_next())
+    argv.emplace_back(splitter.arg());
+
   const std::string executable = fs::path(command.executable).filename();
 
   if (is_cc(executable)) {
-    parse_cc_args(splitter, command);
+    parse_cc_args(argv, command);
   } else if (is_ar(executable)) {
-    parse_ar_args(splitter, command);
+    parse_ar_args(argv, command);
   }
 
+  command.argv = encode_argv(argv);
+
   if (!command.output.empty()) {
     if (options & parse_command_options::expand_path) {
       command.output = expand_path(command.output, command.directory);
@@ -99,25 +162,25 @@ const std::vector<std::string> ignored_single_args = {"-D", "-w", "-W", "-O", "-
                                                       "-ansi", "-pedantic"};
 const std::vector<std::string> ignored_double_args = {"-MT", "-MF"};
 
-bool is_arg(const std::string& arg, const std::vector<std::string>& prefixes) {
+bool is_arg(std::string_view arg, const std::vector<std::string>& prefixes) {
   return std::any_of(prefixes.begin(), prefixes.end(), [&arg](const std::string& prefix){ return starts_with(arg, prefix); });
 }
 
-bool consume_arg(const std::string& arg, const std::string& prefix, size_t& i) {
+bool consume_arg(std::string_view arg, std::string_view prefix, ArgvView::iterator& it) {
   if (starts_with(arg, prefix)) {
     if (arg == prefix)
-      ++i;
+      ++it;
     return true;
   }
 
   return false;
 }
 
-std::string get_arg(const std::vector<std::string>& args, size_t& i) {
-  if (args[i].size() == 2) {
-    return args[++i];
+std::string get_arg(ArgvView::iterator& it, const ArgvView::iterator& end) {
+  if (it->size() == 2) {
+    return ++it != end ? std::string(*it) : std::string();
   } else {
-    return args[i].substr(2);
+    return std::string(it->substr(2));
   }
 }
 
@@ -148,34 +211,34 @@ std::string locate_library(const std::string& name,
 
 Dependencies parse_cc_dependencies(const std::string& /*executable*/,
                                    const fs::path& directory,
-                                   const std::vector<std::string>& argv,
+                                   const ArgvView& argv,
                                    const std::vector<fs::path>& default_library_directories)
 {
   DependenciesResolver resolver;
 
-  auto absolute = [&directory](const std::string& path) { return expand_path(path, directory); };
+  auto absolute = [&directory](std::string_view path) { return expand_path(std::string(path), directory); };
 
   bool openmp = false;
   std::string output_type;
 
-  for(size_t i = 0; i < argv.size(); ++i) {
-    const std::string& arg = argv[i];
+  for(auto it = argv.begin(), end = argv.end(); it != end; ++it) {
+    const std::string_view arg = *it;
 
     if (arg == "-fopenmp") {
       openmp = true;
     } else if (is_arg(arg, ignored_single_args)) {
       continue;
     } else if (is_arg(arg, ignored_double_args)) {
-      ++i;
+      ++it;
     } else if (starts_with(arg, "-L")) {
-      const std::string value = get_arg(argv, i);
+      const std::string value = get_arg(it, end);
       try { resolver.library_directories.emplace_back(absolute(value)); }
       catch (std::filesystem::filesystem_error&) { resolver.errors.emplace_back("Invalid -L " + value); }
     } else if (starts_with(arg, "-l")) {
-      resolver.locate_and_add_library(get_arg(argv, i), default_library_directories);
+      resolver.locate_and_add_library(get_arg(it, end), default_library_directories);
     } else if (starts_with(arg, "-o")) {
-      output_type = get_output_type(get_arg(argv, i));
-    } else if (consume_arg(arg, "-isystem", i) || consume_arg(arg, "-I", i)) {
+      output_type = get_output_type(get_arg(it, end));
+    } else if (consume_arg(arg, "-isystem", it) || consume_arg(arg, "-I", it)) {
 
     } else {
       resolver.dependencies.emplace(absolute(arg).string());
@@ -207,17 +270,15 @@ Dependencies parse_cc_dependencies(const std::string& /*executable*/,
 }
 
 Dependencies parse_ar_dependencies(const fs::path& directory,
-                                   const std::vector<std::string>& argv)
+                                   const ArgvView& argv)
 {
   DependenciesResolver resolver;
 
-  auto absolute = [&directory](const std::string& path) { return expand_path(path, directory); };
+  auto absolute = [&directory](std::string_view path) { return expand_path(std::string(path), directory); };
 
   bool output_found = false;
 
-  for(size_t i = 0; i < argv.size(); ++i) {
-    const std::string& arg = argv[i];
-
+  for(const std::string_view arg : argv) {
     if (ends_with(arg, ".a")) {
       if (!output_found)
         output_found = true;
@@ -250,7 +311,7 @@ void DependenciesResolver::locate_and_add_library(const std::string& namespec,
 Dependencies parse_dependencies(const CompilationCommand& cmd,
                                 const std::vector<fs::path>& default_library_directories)
 {
-  const std::vector<std::string> argv = shellwords::shellsplit(cmd.args);
+  const ArgvView argv = cmd.arguments();
 
   if (is_cc(cmd.executable)) {
     return parse_cc_dependencies(cmd.executable, cmd.directory, argv, default_library_directories);
@@ -261,65 +322,150 @@ Dependencies parse_dependencies(const CompilationCommand& cmd,
   }
 }
 
-std::string redirect_gcc_output(const CompilationCommand& command, const std::string& to) {
-  const std::vector<std::string> argv = shellwords::shellsplit(command.args);
-
-  std::ostringstream ss;
-  ss << command.executable;
+std::vector<std::string> redirect_gcc_output(const CompilationCommand& command, const std::string& to) {
+  std::vector<std::string> argv = {command.executable};
 
-  for(size_t i = 0; i < argv.size(); ++i) {
-    const std::string& arg = argv[i];
+  const ArgvView args = command.arguments();
+  for(auto it = args.begin(), end = args.end(); it != end; ++it) {
+    const std::string_view arg = *it;
 
     if (starts_with(arg, "-o")) {
-      if (!to.empty())
-        ss << " -o " << to;
-
-      if (arg.size() == 2) {
-        ++i;
+      if (!to.empty()) {
+        argv.emplace_back("-o");
+        argv.emplace_back(to);
       }
+
+      if (arg.size() == 2 && ++it == end)
+        break;
     } else {
-      ss << " " << arg;
+      argv.emplace_back(arg);
     }
   }
 
-  return ss.str();
+  return argv;
 }
 
-std::string redirect_ar_output(const CompilationCommand& command, const std::string& to) {
-  const std::vector<std::string> argv = shellwords::shellsplit(command.args);
-
-  std::ostringstream ss;
-  ss << command.executable;
+std::vector<std::string> redirect_ar_output(const CompilationCommand& command, const std::string& to) {
+  std::vector<std::string> argv = {command.executable};
 
   bool output_found = false;
 
-  for(size_t i = 0; i < argv.size(); ++i) {
-    const std::string& arg = argv[i];
-
+  for(const std::string_view arg : command.arguments()) {
     if (ends_with(arg, ".a") && !output_found) {
-        ss << " " << to;
+        if (!to.empty())
+          argv.emplace_back(to);
         output_found = true;
     }
 
-    ss << " " << arg;
+    argv.emplace_back(arg);
   }
 
-  return ss.str();
+  return argv;
 }
 
-void parse_commands(std::istream& in, const std::function<void (size_t, const std::string&, const CompilationCommand&)>& notify)
+void parse_commands(std::istream& in, const std::function<void (size_t, const std::string&, const CompilationCommand&)>& notify, unsigned int threads)
 {
   INSTRMT_FUNCTION();
 
-  std::string line;
-  CompilationCommand cmd;
+  if (threads == 0)
+    threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+  struct Chunk {
+    std::vector<std::string> lines;
+    std::vector<CompilationCommand> commands;
+  };
+
+  constexpr size_t chunk_size = 1024;
+
+  auto parse = [](Chunk& chunk) {
+    chunk.commands.resize(chunk.lines.size());
+    for(size_t i = 0; i < chunk.lines.size(); ++i)
+      parse_command(chunk.lines[i], chunk.commands[i]);
+  };
+
+  struct Pending {
+    Chunk chunk;
+    std::promise<Chunk> parsed;
+  };
+
+  // A fixed set of workers parse the chunks. With a single thread, each chunk is parsed when it is consumed.
+  BoundedQueue<Pending> pending(2 * threads);
+  std::vector<std::thread> workers;
+
+  // Also on errors: pending chunks are dropped, their futures are abandoned.
+  struct Join {
+    BoundedQueue<Pending>& pending;
+    std::vector<std::thread>& workers;
+    ~Join() {
+      pending.abort();
+      for(std::thread& worker : workers)
+        worker.join();
+    }
+  } join{pending, workers};
+
+  for(unsigned int t = 0; threads > 1 && t < threads; ++t) {
+    workers.emplace_back([&pending, &parse]{
+      std::vector<Pending> batch;
+      std::chrono::steady_clock::duration waited;
+
+      while (pending.pop(batch, 1, waited) > 0) {
+        Pending& p = batch.front();
+        try {
+          parse(p.chunk);
+          p.parsed.set_value(std::move(p.chunk));
+        } catch (...) {
+          p.parsed.set_exception(std::current_exception());
+        }
+        batch.clear();
+      }
+    });
+  }
+
+  // Reorder buffer: chunks are parsed concurrently but consumed in the order they were read.
+  std::deque<std::future<Chunk>> parsing;
+  bool eof = false;
   size_t item = 0UL;
 
-  while (std::getline(in, line) && !line.empty()) {
-    clear(cmd);
-    parse_command(line, cmd);
-    notify(item, line, cmd);
-    ++item;
+  while (!eof || !parsing.empty()) {
+    while (!eof && parsing.size() < 2 * threads) {
+      Chunk chunk;
+      chunk.lines.reserve(chunk_size);
+
+      std::string line;
+      while (chunk.lines.size() < chunk_size) {
+        if (!std::getline(in, line) || line.empty()) {
+          eof = true;
+          break;
+        }
+        chunk.lines.emplace_back(std::move(line));
+      }
+
+      if (chunk.lines.empty())
+        break;
+
+      if (workers.empty()) {
+        parsing.emplace_back(std::async(std::launch::deferred, [&parse](Chunk chunk){
+          parse(chunk);
+          return chunk;
+        }, std::move(chunk)));
+      } else {
+        Pending p{std::move(chunk), {}};
+        parsing.emplace_back(p.parsed.get_future());
+        pending.push(std::move(p));
+      }
+    }
+
+    if (parsing.empty())
+      break;
+
+    // Parsing errors are thrown here, once the commands before them have been notified.
+    const Chunk chunk = parsing.front().get();
+    parsing.pop_front();
+
+    for(size_t i = 0; i < chunk.lines.size(); ++i) {
+      notify(item, chunk.lines[i], chunk.commands[i]);
+      ++item;
+    }
   }
 }
 
@@ -327,29 +473,61 @@ void parse_compile_commands(std::istream& in, const std::function<void (size_t,
 {
   INSTRMT_FUNCTION();
 
-  pt::ptree tree;
-  try { pt::read_json(in, tree); }
-  catch (...) { std::throw_with_nested(std::runtime_error("Unable to parse JSON")); }
+  // Entries are read one at a time, memory does not grow with the size of the compilation database.
+  JsonReader json(in);
 
   CompilationCommand cmd;
+  std::string key, line;
+  std::vector<std::string> arguments;
   size_t item = 0UL;
 
-  for(const pt::ptree::value_type& entry : tree) {
+  json.begin_array();
+
+  while (json.next_element()) {
     clear(cmd);
+    line.clear();
+    arguments.clear();
+    bool has_arguments = false;
+
+    json.begin_object();
+
+    while (json.next_member(key)) {
+      if (key == "directory") {
+        cmd.directory = json.read_string();
+      } else if (key == "command") {
+        line = json.read_string();
+      } else if (key == "arguments") {
+        has_arguments = true;
+        json.begin_array();
+        while (json.next_element())
+          arguments.emplace_back(json.read_string());
+      } else {
+        json.skip_value();
+      }
+    }
+
+    // Relative paths would be resolved against the current directory.
+    if (cmd.directory.empty())
+      throw std::runtime_error("Invalid compilation database: entry " + std::to_string(item) + " has no \"directory\"");
+
+    // Preferred over "command" when both are given, like clang tools do.
+    if (has_arguments)
+      line = shell_join(arguments);
+    else if (line.empty())
+      throw std::runtime_error("Invalid compilation database: entry " + std::to_string(item) + " has neither \"command\" nor \"arguments\"");
 
-    const auto& data = entry.second;
-    cmd.directory = data.get_child("directory").data();
-    const std::string line = data.get_child("command").data();
     parse_command(line, cmd, parse_command_options::expand_path);
 
     notify(item, line, cmd);
     ++item;
   }
+
+  json.end();
 }
 
 void CommandImporter::import_commands(std::istream& in)
 {
-  parse_commands(in, [this](auto ...args){ on_command(args...); });
+  parse_commands(in, [this](auto ...args){ on_command(args...); }, threads);
 }
 
 void CommandImporter::import_compile_commands(std::istream& in)
@@ -368,7 +546,7 @@ void CommandImporter::on_command(size_t /*item*/, const std::string& /*line*/, c
   if (command.output.empty())
     throw std::runtime_error("Invalid commant: output could not be identified");
 
-  const long long command_id = db.create_command(command.directory, command.executable, command.args);
+  const long long command_id = db.create_command(command.directory, command.executable, command.args, command.argv);
 
   if (-1 == db.artifact_id_by_name(command.output)) {
     db.create_artifact(command.output, command.output_type, command_id);
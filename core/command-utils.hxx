@@ -2,22 +2,84 @@
 #define COMMANDUTILS_HXX
 
 #include <filesystem>
+#include <cstddef>
 #include <functional>
 #include <iosfwd>
+#include <iterator>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Database2;
 
 bool is_cc(const std::string& command);
 
+// Arguments stored back to back, each one preceded by its length on 4 bytes (little-endian).
+std::string encode_argv(const std::vector<std::string>& argv);
+
+// Forward range over the arguments encoded by encode_argv(), decoded while iterating: nothing is allocated.
+// Views into encoded, which must outlive them.
+class ArgvView {
+public:
+  class iterator {
+  private:
+    std::string_view mRest;
+    std::string_view mArg;
+    bool mEnd = true;
+
+    void next();
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    iterator() = default;
+    explicit iterator(std::string_view encoded) : mRest(encoded), mEnd(false) { next(); }
+
+    reference operator*() const { return mArg; }
+    pointer operator->() const { return &mArg; }
+
+    iterator& operator++() { next(); return *this; }
+    iterator operator++(int) { iterator it = *this; next(); return it; }
+
+    bool operator==(const iterator& other) const {
+      return mEnd == other.mEnd && (mEnd || mRest.data() == other.mRest.data());
+    }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+  };
+
+  using const_iterator = iterator;
+  using value_type = std::string_view;
+
+  explicit ArgvView(std::string_view encoded) : mEncoded(encoded) {}
+
+  iterator begin() const { return iterator(mEncoded); }
+  iterator end() const { return iterator(); }
+  bool empty() const { return mEncoded.empty(); }
+
+private:
+  std::string_view mEncoded;
+};
+
+// Views into encoded, which must outlive them.
+std::vector<std::string_view> decode_argv(std::string_view encoded);
+
 class Command {
 public:
   long long id = -1;
   std::string directory;
   std::string executable;
   std::string args;
+
+  // args split once at import, encoded by encode_argv().
+  std::string argv;
+
+  // Views into argv, valid as long as the command is not modified.
+  ArgvView arguments() const { return ArgvView(argv); }
 };
 
 class CompilationCommand : public Command {
@@ -34,8 +96,12 @@ namespace parse_command_options {
 
 void parse_command(const std::string& line, CompilationCommand& command, const int options = parse_command_options::with_directory | parse_command_options::expand_path);
 
+// Lines are parsed by chunks on `threads` threads (0: one per hardware thread),
+// notify() is called from the calling thread in the order of the input.
+// parse_command() runs concurrently: expand_path() serializes wordexp(), which is not thread-safe.
 void parse_commands(std::istream& in,
-                    const std::function<void (size_t, const std::string&, const CompilationCommand&)>& notify);
+                    const std::function<void (size_t, const std::string&, const CompilationCommand&)>& notify,
+                    unsigned int threads = 1);
 
 void parse_compile_commands(std::istream& in,
                             const std::function<void(size_t, const std::string&, const CompilationCommand&)>& notify);
@@ -44,11 +110,13 @@ class CommandImporter
 {
 private:
   Database2& db;
+  unsigned int threads;
   size_t count = 0UL;
 
 public:
-  CommandImporter(Database2& db)
+  CommandImporter(Database2& db, unsigned int threads = 1)
    : db(db)
+   , threads(threads)
   {}
 
   void import_commands(std::istream& in);
@@ -83,8 +151,9 @@ public:
 Dependencies parse_dependencies(const CompilationCommand& cmd,
                                 const std::vector<std::filesystem::path>& default_library_directories);
 
-std::string redirect_gcc_output(const CompilationCommand& command, const std::string& to = {});
+// argv of the command with its output replaced by `to` (removed when empty), executable first.
+std::vector<std::string> redirect_gcc_output(const CompilationCommand& command, const std::string& to = {});
 
-std::string redirect_ar_output(const CompilationCommand& command, const std::string& to = {});
+std::vector<std::string> redirect_ar_output(const CompilationCommand& command, const std::string& to = {});
 
 #endif // COMMANDUTILS_HXX
@@ -0,0 +1,47 @@
+#include "connection-pool.hxx"
+
+ConnectionPool::ConnectionPool(Database2& db)
+  : mFile(db.database().getFilename())
+  , mProfile(db.storage_profile())
+  , mReadOnly(db.read_only())
+  , mIdle{&db}
+{}
+
+size_t ConnectionPool::size()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mConnections.size() + 1;
+}
+
+ConnectionPool::Lease ConnectionPool::acquire()
+{
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    if (!mReadOnly)
+      mReleased.wait(lock, [this]{ return !mIdle.empty(); });
+
+    if (!mIdle.empty()) {
+      Database2* db = mIdle.back();
+      mIdle.pop_back();
+      return Lease(*this, db);
+    }
+  }
+
+  // Opened outside of the lock, the schema is read by the constructor.
+  auto db = std::make_unique<Database2>(mFile, OpenMode::read_only);
+  db->set_storage_profile(mProfile);
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mConnections.emplace_back(std::move(db));
+  return Lease(*this, mConnections.back().get());
+}
+
+void ConnectionPool::release(Database2* db)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mIdle.push_back(db);
+  }
+  mReleased.notify_one();
+}
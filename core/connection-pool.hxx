@@ -0,0 +1,53 @@
+#ifndef CONNECTIONPOOL_HXX
+#define CONNECTIONPOOL_HXX
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/core/noncopyable.hpp>
+
+#include "Database2.hxx"
+
+// Lends database connections to one thread at a time.
+class ConnectionPool : boost::noncopyable {
+private:
+  const std::string mFile;
+  const StorageProfile mProfile;
+  // Other connections can only be opened next to a read-only one.
+  const bool mReadOnly;
+
+  std::mutex mMutex;
+  std::condition_variable mReleased;
+  std::vector<std::unique_ptr<Database2>> mConnections;
+  std::vector<Database2*> mIdle;
+
+  void release(Database2* db);
+
+public:
+  class Lease : boost::noncopyable {
+  private:
+    ConnectionPool& mPool;
+    Database2* mDb;
+
+  public:
+    Lease(ConnectionPool& pool, Database2* db) : mPool(pool), mDb(db) {}
+    ~Lease() { mPool.release(mDb); }
+
+    Database2& operator*() const { return *mDb; }
+    Database2* operator->() const { return mDb; }
+  };
+
+  // Read-only databases: a connection is opened for each thread using the pool concurrently,
+  // with the storage profile of db. Otherwise db itself is lent and the threads take turns.
+  explicit ConnectionPool(Database2& db);
+
+  size_t size();
+
+  // Blocks until a connection is available.
+  Lease acquire();
+};
+
+#endif // CONNECTIONPOOL_HXX
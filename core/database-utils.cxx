@@ -1,8 +1,13 @@
 #include "database-utils.hxx"
 
+#include <algorithm>
 #include <fstream>
+#include <atomic>
 #include <chrono>
+#include <exception>
 #include <filesystem>
+#include <memory>
+#include <thread>
 #include <omp.h>
 
 #include "ansi.hxx"
@@ -11,13 +16,16 @@
 #include "command-utils.hxx"
 #include "utils.hxx"
 #include "nm.hxx"
+#include "elf.hxx"
+#include "archive.hxx"
+#include "mapped-file.hxx"
 #include "ArtifactSymbols.hxx"
+#include "bounded-queue.hxx"
+#include "process-reactor.hxx"
 
-#include <boost/process.hpp>
 #include <instrmt/instrmt.hxx>
 
 namespace fs = std::filesystem;
-namespace bp = boost::process;
 using ansi::style;
 
 namespace {
@@ -25,8 +33,8 @@ namespace {
 std::vector<fs::path> load_default_library_directories() {
   LOG_CTX() << style::blue_fg << "Extracting system libraries potential locations" << style::reset;
 
-  bp::ipstream pipe_stream;
-  bp::child c("gcc --print-search-dir", bp::std_out > pipe_stream, bp::std_err > bp::null);
+  Process c("gcc --print-search-dir", {}, Process::output::pipe, Process::output::null);
+  PipeStream pipe_stream(c.out());
 
   std::vector<fs::path> paths;
 
@@ -69,30 +77,7 @@ long long get_or_insert_artifact(Database2& db, const std::string& name, const s
   return artifact_id;
 }
 
-class out_pool_scheduler {
-private:
-  ThreadPool& pool;
-public:
-  explicit out_pool_scheduler(ThreadPool& pool) : pool(pool) {}
-  std::future<void> operator()(std::istream& stream, SymbolReferenceSet& symbols) {
-    return pool.enqueue(parse_nm_output, std::ref(stream), std::ref(symbols));
-  }
-};
-
-class err_pool_scheduler {
-private:
-  ThreadPool& pool;
-public:
-  explicit err_pool_scheduler(ThreadPool& pool) : pool(pool) {}
-  std::future<std::string> operator()(std::istream& stream) {
-    return pool.enqueue(read_stream, std::ref(stream));
-  }
-};
-
-void extract_symbols_from_file(const Artifact& artifact,
-                               SymbolExtractionStatus& status,
-                               const std::function<std::future<void>(std::istream& stream, SymbolReferenceSet& symbols)>& out_runner,
-                               const std::function<std::future<std::string>(std::istream& stream)>& err_runner) {
+void extract_symbols_with_nm(const Artifact& artifact, SymbolExtractionStatus& status, ProcessReactor& reactor) {
   INSTRMT_FUNCTION();
 
   const std::string& usable_path = artifact.name;
@@ -102,24 +87,79 @@ void extract_symbols_from_file(const Artifact& artifact,
   char magic[4] = {0, 0, 0, 0};
   file.read(magic, 4);
   file.close();
-  status.linker_script = !(magic[0] == 0x7f && magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F');
+  status.linker_script = !elf::is_elf(magic, sizeof(magic));
 
   if (!status.linker_script) {
     ArtifactSymbols& symbols = status.symbols;
 
-    status.processes.emplace_back(nm(usable_path, symbols.undefined, nm_options::undefined, out_runner, err_runner));
-    if (is_dynamic && symbols.undefined.empty())
-      status.processes.emplace_back(nm(usable_path, symbols.undefined, nm_options::undefined_dynamic, out_runner, err_runner));
+    // The three listings run concurrently, within the reactor process budget.
+    // Their outputs are parsed by the reactor thread as they are read.
+    std::future<ProcessResult> undefined = nm(reactor, usable_path, nm_options::undefined, symbols.undefined);
+    std::future<ProcessResult> external  = nm(reactor, usable_path, nm_options::defined_extern, symbols.external);
+    std::future<ProcessResult> internal  = nm(reactor, usable_path, nm_options::defined, symbols.internal);
+
+    status.processes.emplace_back(undefined.get());
+    status.processes.emplace_back(external.get());
+    status.processes.emplace_back(internal.get());
+
+    // Stripped shared libraries only have dynamic symbols.
+    if (is_dynamic) {
+      if (symbols.undefined.empty())
+        undefined = nm(reactor, usable_path, nm_options::undefined_dynamic, symbols.undefined);
+      if (symbols.external.empty())
+        external = nm(reactor, usable_path, nm_options::defined_extern_dynamic, symbols.external);
+      if (symbols.internal.empty())
+        internal = nm(reactor, usable_path, nm_options::defined_dynamic, symbols.internal);
+
+      if (undefined.valid())
+        status.processes.emplace_back(undefined.get());
+      if (external.valid())
+        status.processes.emplace_back(external.get());
+      if (internal.valid())
+        status.processes.emplace_back(internal.get());
+    }
+
+    substract_set(symbols.internal, symbols.external);
+  }
+}
+
+void extract_archive_symbols(Archive& archive, SymbolExtractionStatus& status) {
+  for(const Archive::Member& member : archive.members()) {
+    if (!elf::is_elf(member.data, member.size))
+      continue;
+
+    status.members.emplace_back();
+    ArchiveMemberSymbols& member_symbols = status.members.back();
+    member_symbols.member = member.name;
 
-    status.processes.emplace_back(nm(usable_path, symbols.external, nm_options::defined_extern, out_runner, err_runner));
-    if (is_dynamic && symbols.external.empty())
-      status.processes.emplace_back(nm(usable_path, symbols.external, nm_options::defined_extern_dynamic, out_runner, err_runner));
+    try {
+      elf::read_symbols(member.data, member.size, member_symbols.symbols);
+    } catch (const std::exception& ex) {
+      status.errors.emplace_back(member.name + ": " + ex.what());
+    }
+  }
+}
 
-    status.processes.emplace_back(nm(usable_path, symbols.external, nm_options::defined, out_runner, err_runner));
-    if (is_dynamic && symbols.external.empty())
-      status.processes.emplace_back(nm(usable_path, symbols.external, nm_options::defined_dynamic, out_runner, err_runner));
+void extract_symbols_with_elf(const Artifact& artifact, SymbolExtractionStatus& status) {
+  INSTRMT_FUNCTION();
 
-    substract_set(symbols.internal, symbols.external);
+  try {
+    auto file = std::make_unique<MappedFile>(artifact.name);
+
+    if (Archive::is_archive(file->data(), file->size())) {
+      Archive archive(std::move(file), artifact.name);
+      extract_archive_symbols(archive, status);
+      return;
+    }
+
+    status.linker_script = !elf::is_elf(file->data(), file->size());
+
+    if (!status.linker_script) {
+      elf::read_symbols(file->data(), file->size(), status.symbols);
+      status.identity.build_id = elf::build_id(file->data(), file->size());
+    }
+  } catch (const std::exception& ex) {
+    status.errors.emplace_back(ex.what());
   }
 }
 
@@ -131,15 +171,24 @@ void DependenciesExtractor::run(Database2& db)
 
   const std::vector<fs::path> default_library_directories = load_default_library_directories();
 
+  // Commands are processed in order, an interrupted extraction resumes after the last one committed.
+  const long long resume_after = db.get_progress("extract-dependencies");
+  if (resume_after != -1)
+    LOG(info) << "Resuming dependency extraction after command #" << resume_after;
+
   if (notifyTotalSteps) {
-    auto cq = db.statement("select count(*) from commands");
+    auto cq = db.statement("select count(*) from commands where id > ?");
+    cq.bind(1, resume_after);
     notifyTotalSteps(db.get_id(cq));
   }
 
   auto stm = db.statement(R"(
-select commands.id, commands.directory, commands.executable, commands.args, artifacts.id, artifacts.name, artifacts.type
+select commands.id, commands.directory, commands.executable, commands.args, commands.argv, artifacts.id, artifacts.name, artifacts.type
 from commands
-inner join artifacts on artifacts.generating_command_id = commands.id)");
+inner join artifacts on artifacts.generating_command_id = commands.id
+where commands.id > ?
+order by commands.id)");
+  stm.bind(1, resume_after);
 
   while (stm.executeStep()) {
     CompilationCommand cmd;
@@ -147,9 +196,10 @@ inner join artifacts on artifacts.generating_command_id = commands.id)");
     cmd.directory   = stm.getColumn(1).getString();
     cmd.executable  = stm.getColumn(2).getString();
     cmd.args        = stm.getColumn(3).getString();
-    cmd.artifact_id = stm.getColumn(4).getInt64();
-    cmd.output      = stm.getColumn(5).getString();
-    cmd.output_type = stm.getColumn(6).getString();
+    cmd.argv        = stm.getColumn(4).getString();
+    cmd.artifact_id = stm.getColumn(5).getInt64();
+    cmd.output      = stm.getColumn(6).getString();
+    cmd.output_type = stm.getColumn(7).getString();
 
     const Dependencies dependencies = parse_dependencies(cmd, default_library_directories);
 
@@ -168,7 +218,14 @@ inner join artifacts on artifacts.generating_command_id = commands.id)");
 
     if (notifyStep)
       notifyStep(cmd, artifacts, dependencies.errors);
+
+    if (db.checkpoint_due()) {
+      db.set_progress("extract-dependencies", cmd.id);
+      db.checkpoint();
+    }
   }
+
+  db.clear_progress("extract-dependencies");
 }
 
 bool has_failure(const std::vector<ProcessResult>& processes) {
@@ -176,46 +233,236 @@ bool has_failure(const std::vector<ProcessResult>& processes) {
 }
 
 bool has_failure(const SymbolExtractionStatus& status) {
-  return status.linker_script || has_failure(status.processes);
+  return status.linker_script || !status.errors.empty() || has_failure(status.processes);
 }
 
-SymbolExtractor::SymbolExtractor(size_t pool_size)
+SymbolExtractor::SymbolExtractor(size_t pool_size, symbol_backend backend)
   : pool_size(pool_size)
-  , out_pool(pool_size)
-  , err_pool(pool_size)
-  , out_runner(out_pool_scheduler(out_pool))
-  , err_runner(err_pool_scheduler(err_pool))
+  , backend(backend)
+  , queue_capacity(4 * pool_size)
+  , batch_size(64)
 {}
 
-void SymbolExtractor::run(Database2& db)
+SymbolExtractionStats SymbolExtractor::run(Database2& db)
 {
   INSTRMT_REGION("SymbolExtractor::run");
 
-  auto q = db.statement("select id, name, type from artifacts where type not in (\"source\", \"static\")");
+  SymbolExtractionStats stats;
 
-  auto cq = db.statement("select count(*) from artifacts where type not in (\"source\", \"static\")");
-  if (notifyTotalSteps)
-    notifyTotalSteps(db.get_id(cq));
+  // Archives are only supported by the ELF backend, parse_nm_output() does not handle per-member listings.
+  const std::string excluded_types = backend == symbol_backend::nm ? "(\"source\", \"static\")" : "(\"source\")";
+
+  auto q = db.statement(R"(
+select artifacts.id, artifacts.name, artifacts.type,
+       artifact_files.device, artifact_files.inode, artifact_files.size, artifact_files.mtime_ns, artifact_files.build_id
+from artifacts
+left join artifact_files on artifact_files.artifact_id = artifacts.id
+where artifacts.type not in )" + excluded_types);
+
+  struct Pending {
+    Artifact artifact;
+    FileIdentity previous;
+    size_t size;
+  };
+
+  // Only the artifacts whose identity changed since the last run are extracted again.
+  std::vector<Pending> pending;
 
-#pragma omp parallel num_threads(pool_size)
-#pragma omp single
   while (q.executeStep()) {
     Artifact artifact;
     artifact.id   = q.getColumn(0).getInt64();
     artifact.name = q.getColumn(1).getText();
     artifact.type = q.getColumn(2).getText();
 
-#pragma omp task firstprivate(artifact)
-    {
-      SymbolExtractionStatus status;
-      extract_symbols_from_file(artifact, status, out_runner, err_runner);
-#pragma omp critical
-      {
-        db.insert_symbol_references(artifact.id, status.symbols);
-
-        if (notifyStep)
-          notifyStep(artifact, status);
+    FileIdentity previous;
+    if (!q.getColumn(3).isNull()) {
+      previous.device   = q.getColumn(3).getInt64();
+      previous.inode    = q.getColumn(4).getInt64();
+      previous.size     = q.getColumn(5).getInt64();
+      previous.mtime_ns = q.getColumn(6).getInt64();
+      previous.build_id = q.getColumn(7).getText();
+    }
+
+    FileIdentity current;
+    if (!stat_file(artifact.name, current)) {
+      if (previous.valid()) {
+        db.delete_symbol_references(artifact.id);
+        db.delete_artifact_identity(artifact.id);
+        ++stats.dropped;
+        continue;
+      }
+    } else if (previous.valid()) {
+      if (current.same_file(previous)) {
+        ++stats.skipped;
+        continue;
+      }
+
+      // Touched or copied over but same content, e.g. relinked with a reproducible toolchain.
+      if (!previous.build_id.empty() && file_build_id(artifact.name) == previous.build_id) {
+        current.build_id = previous.build_id;
+        db.set_artifact_identity(artifact.id, current);
+        ++stats.skipped;
+        continue;
+      }
+    }
+
+    pending.push_back({std::move(artifact), previous, current.size > 0 ? static_cast<size_t>(current.size) : 0UL});
+  }
+
+  q.reset();
+
+  // Largest first, so that a big executable does not end up alone at the tail of the run.
+  std::stable_sort(pending.begin(), pending.end(), [](const Pending& lhs, const Pending& rhs) {
+    return lhs.size > rhs.size;
+  });
+
+  // Artifacts committed by an interrupted extraction are skipped above, their identity is recorded.
+  const long long resumed = db.get_progress("extract-symbols");
+  if (resumed != -1)
+    LOG(info) << "Resuming symbol extraction, " << resumed << " artifacts already extracted";
+  long long written = std::max(resumed, 0LL);
+
+  if (notifyTotalSteps) {
+    size_t total_size = 0UL;
+    for(const Pending& p : pending)
+      total_size += p.size;
+    notifyTotalSteps(pending.size(), total_size);
+  }
+
+  struct Extracted {
+    size_t index;
+    bool exists;
+    SymbolExtractionStatus status;
+  };
+
+  // Extraction runs in parallel, a single writer owns the database and drains the results in batches.
+  BoundedQueue<Extracted> queue(queue_capacity);
+  std::exception_ptr writer_error;
+  // Set when the writer fails, the remaining artifacts are not extracted.
+  std::atomic<bool> aborted(false);
+  size_t depth_samples = 0;
+
+  std::thread writer([&]{
+    INSTRMT_REGION("SymbolExtractor::writer");
+
+    bool in_batch = false;
+
+    try {
+      std::vector<Extracted> batch; batch.reserve(batch_size);
+
+      for(;;) {
+        batch.clear();
+
+        std::chrono::steady_clock::duration waited;
+        const size_t depth = queue.pop(batch, batch_size, waited);
+        stats.writer_stall += std::chrono::duration_cast<std::chrono::nanoseconds>(waited);
+
+        if (batch.empty())
+          break;
+
+        ++depth_samples;
+        stats.mean_queue_depth += (depth - stats.mean_queue_depth) / depth_samples;
+        stats.max_queue_depth = std::max(stats.max_queue_depth, depth);
+        ++stats.batches;
+
+        // The whole task already runs in a transaction, a savepoint scopes each batch.
+        db.database().exec("savepoint symbol_batch;");
+        in_batch = true;
+
+        for(const Extracted& extracted : batch) {
+          const Artifact& artifact = pending[extracted.index].artifact;
+          const FileIdentity& previous = pending[extracted.index].previous;
+          const SymbolExtractionStatus& status = extracted.status;
+
+          if (previous.valid()) {
+            db.delete_symbol_references(artifact.id);
+            ++stats.refreshed;
+          } else {
+            ++stats.extracted;
+          }
+
+          db.insert_symbol_references(artifact.id, status.symbols);
+
+          for(const ArchiveMemberSymbols& member : status.members)
+            db.insert_symbol_references(artifact.id, db.create_archive_member(artifact.id, member.member), member.symbols);
+
+          // Failed extractions are retried on the next run.
+          if (extracted.exists && status.errors.empty() && !has_failure(status.processes))
+            db.set_artifact_identity(artifact.id, status.identity);
+          else
+            db.delete_artifact_identity(artifact.id);
+
+          if (notifyStep)
+            notifyStep(artifact, status);
+        }
+
+        db.database().exec("release symbol_batch;");
+        in_batch = false;
+
+        written += static_cast<long long>(batch.size());
+        if (db.checkpoint_due(batch.size())) {
+          db.demangle_symbols(pool_size);
+          db.set_progress("extract-symbols", written);
+          db.checkpoint();
+        }
+      }
+    } catch (...) {
+      // The failed batch is discarded, the task transaction can still be checkpointed or committed.
+      if (in_batch) {
+        try {
+          db.database().exec("rollback to symbol_batch; release symbol_batch;");
+        } catch (...) {}
       }
+
+      writer_error = std::current_exception();
+      aborted = true;
+      queue.abort();
+    }
+  });
+
+  std::atomic<long long> extractor_stall(0);
+
+  // nm children are multiplexed on a single thread, as many run as there are extraction threads.
+  std::unique_ptr<ProcessReactor> reactor;
+  if (backend == symbol_backend::nm)
+    reactor = std::make_unique<ProcessReactor>(pool_size);
+
+  // Idle threads pick the next largest artifact.
+#pragma omp parallel for num_threads(pool_size) schedule(dynamic, 1)
+  for(size_t i = 0; i < pending.size(); ++i) {
+    if (aborted)
+      continue;
+
+    const Artifact& artifact = pending[i].artifact;
+
+    Extracted extracted;
+    extracted.index = i;
+    extracted.exists = stat_file(artifact.name, extracted.status.identity);
+    if (backend == symbol_backend::nm) {
+      extract_symbols_with_nm(artifact, extracted.status, *reactor);
+      extracted.status.identity.build_id = file_build_id(artifact.name);
+    } else {
+      extract_symbols_with_elf(artifact, extracted.status);
     }
+
+    const auto waited = queue.push(std::move(extracted));
+    extractor_stall += std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count();
+  }
+
+  queue.close();
+  writer.join();
+
+  stats.extractor_stall = std::chrono::nanoseconds(extractor_stall.load());
+
+  if (writer_error)
+    std::rethrow_exception(writer_error);
+
+  {
+    INSTRMT_REGION("SymbolExtractor::demangle");
+    db.demangle_symbols(pool_size);
   }
+
+  db.clear_progress("extract-symbols");
+
+  return stats;
 }
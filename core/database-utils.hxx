@@ -1,6 +1,7 @@
 #ifndef DATABASEUTILS_HXX
 #define DATABASEUTILS_HXX
 
+#include <chrono>
 #include <vector>
 #include <string>
 #include <functional>
@@ -9,7 +10,7 @@
 
 #include "process-utils.hxx"
 #include "ArtifactSymbols.hxx"
-#include "ThreadPool.hpp"
+#include "file-identity.hxx"
 
 class Database2;
 class CompilationCommand;
@@ -24,12 +25,34 @@ public:
   void run(Database2& db);
 };
 
+enum class symbol_backend {
+  elf,
+  nm
+};
+
 struct SymbolExtractionStatus {
   std::vector<ProcessResult> processes;
+  std::vector<std::string> errors;
   ArtifactSymbols symbols;
+  std::vector<ArchiveMemberSymbols> members;
+  FileIdentity identity;
   bool linker_script = false;
 };
 
+struct SymbolExtractionStats {
+  size_t extracted = 0; // first extraction
+  size_t refreshed = 0; // identity changed since the last extraction
+  size_t skipped = 0;   // identity unchanged
+  size_t dropped = 0;   // file removed, references deleted
+
+  // Extractors feed a single writer, these tell which side waits for the other.
+  size_t batches = 0;
+  size_t max_queue_depth = 0;
+  double mean_queue_depth = 0.0; // sampled each time the writer wakes up
+  std::chrono::nanoseconds writer_stall{0};    // writer waiting for extraction results
+  std::chrono::nanoseconds extractor_stall{0}; // extractors waiting for room in the queue, summed over threads
+};
+
 bool has_failure(const std::vector<ProcessResult>& processes);
 
 bool has_failure(const SymbolExtractionStatus& status);
@@ -37,16 +60,16 @@ bool has_failure(const SymbolExtractionStatus& status);
 class SymbolExtractor {
 private:
   size_t pool_size;
-  ThreadPool out_pool, err_pool;
-  std::function<std::future<void>(std::istream& stream, SymbolReferenceSet& symbols)> out_runner;
-  std::function<std::future<std::string>(std::istream& stream)> err_runner;
+  symbol_backend backend;
+  size_t queue_capacity; // extraction results waiting for the writer
+  size_t batch_size;     // artifacts written per savepoint
 
 public:
-  std::function<void(const size_t)> notifyTotalSteps;
+  std::function<void(const size_t steps, const size_t bytes)> notifyTotalSteps;
   std::function<void(const Artifact&, const SymbolExtractionStatus&)> notifyStep;
 
-  explicit SymbolExtractor(size_t pool_size);
-  void run(Database2& db);
+  explicit SymbolExtractor(size_t pool_size, symbol_backend backend = symbol_backend::elf);
+  SymbolExtractionStats run(Database2& db);
 };
 
 #endif // DATABASEUTILS_HXX
@@ -0,0 +1,327 @@
+#include "elf.hxx"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <elf.h>
+
+#include "nm.hxx"
+#include "ArtifactSymbols.hxx"
+
+namespace {
+
+struct Elf32 {
+  using Ehdr = Elf32_Ehdr;
+  using Shdr = Elf32_Shdr;
+  using Sym  = Elf32_Sym;
+  using Nhdr = Elf32_Nhdr;
+};
+
+struct Elf64 {
+  using Ehdr = Elf64_Ehdr;
+  using Shdr = Elf64_Shdr;
+  using Sym  = Elf64_Sym;
+  using Nhdr = Elf64_Nhdr;
+};
+
+template<typename T>
+T byteswap(T value) {
+  char* bytes = reinterpret_cast<char*>(&value);
+  std::reverse(bytes, bytes + sizeof(T));
+  return value;
+}
+
+class Image {
+private:
+  const char* data;
+  size_t size;
+  bool swap;
+
+public:
+  Image(const char* data, size_t size, bool swap)
+    : data(data), size(size), swap(swap)
+  {}
+
+  // The image may not be suitably aligned (e.g. archive members), always copy.
+  template<typename T>
+  T load(size_t offset) const {
+    if (offset > size || size - offset < sizeof(T))
+      throw std::runtime_error("Truncated ELF file");
+
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+  }
+
+  template<typename T>
+  T fix(T value) const { return swap ? byteswap(value) : value; }
+
+  std::string_view string(size_t table_offset, size_t table_size, size_t index) const {
+    if (index >= table_size || table_offset > size || size - table_offset < table_size)
+      throw std::runtime_error("Invalid string table index");
+
+    const char* str = data + table_offset + index;
+    const char* end = static_cast<const char*>(std::memchr(str, 0, table_size - index));
+    return std::string_view(str, end ? end - str : table_size - index);
+  }
+};
+
+// Same letters as nm(1).
+template<typename Traits>
+char symbol_type(const Image& image,
+                 const typename Traits::Sym& sym,
+                 const std::vector<typename Traits::Shdr>& sections) {
+  const unsigned char bind = ELF64_ST_BIND(sym.st_info);
+  const unsigned char type = ELF64_ST_TYPE(sym.st_info);
+  const uint16_t shndx = image.fix(sym.st_shndx);
+
+  if (shndx == SHN_UNDEF) {
+    if (bind == STB_WEAK)
+      return type == STT_OBJECT ? 'v' : 'w';
+    return 'U';
+  }
+
+  if (shndx == SHN_COMMON)
+    return 'C';
+
+  if (bind == STB_GNU_UNIQUE)
+    return 'u';
+
+  if (type == STT_GNU_IFUNC)
+    return 'i';
+
+  if (bind == STB_WEAK)
+    return type == STT_OBJECT ? 'V' : 'W';
+
+  char c = '?';
+  if (shndx == SHN_ABS) {
+    c = 'A';
+  } else if (shndx < sections.size()) {
+    const auto& section = sections[shndx];
+    const auto flags = image.fix(section.sh_flags);
+    if (flags & SHF_EXECINSTR)
+      c = 'T';
+    else if (!(flags & SHF_ALLOC))
+      c = 'N';
+    else if (image.fix(section.sh_type) == SHT_NOBITS)
+      c = 'B';
+    else if (flags & SHF_WRITE)
+      c = 'D';
+    else
+      c = 'R';
+  }
+
+  return bind == STB_LOCAL ? static_cast<char>(std::tolower(c)) : c;
+}
+
+template<typename Traits>
+std::vector<typename Traits::Shdr> load_sections(const Image& image) {
+  using Ehdr = typename Traits::Ehdr;
+  using Shdr = typename Traits::Shdr;
+
+  const Ehdr header = image.load<Ehdr>(0);
+  const size_t shoff = image.fix(header.e_shoff);
+  const size_t shnum = image.fix(header.e_shnum);
+
+  std::vector<Shdr> sections;
+
+  if (shoff == 0 || shnum == 0)
+    return sections;
+
+  if (image.fix(header.e_shentsize) != sizeof(Shdr))
+    throw std::runtime_error("Unexpected ELF section header size");
+
+  sections.reserve(shnum);
+  for(size_t i = 0; i < shnum; ++i)
+    sections.emplace_back(image.load<Shdr>(shoff + i * sizeof(Shdr)));
+
+  return sections;
+}
+
+// Looks for a NT_GNU_BUILD_ID note in the SHT_NOTE sections.
+template<typename Traits>
+std::string build_id(const Image& image) {
+  using Shdr = typename Traits::Shdr;
+  using Nhdr = typename Traits::Nhdr;
+
+  static const char hex[] = "0123456789abcdef";
+
+  for(const Shdr& section : load_sections<Traits>(image)) {
+    if (image.fix(section.sh_type) != SHT_NOTE)
+      continue;
+
+    size_t offset = image.fix(section.sh_offset);
+    const size_t end = offset + image.fix(section.sh_size);
+
+    while (offset + sizeof(Nhdr) <= end) {
+      const Nhdr note = image.load<Nhdr>(offset);
+      const size_t namesz = image.fix(note.n_namesz);
+      const size_t descsz = image.fix(note.n_descsz);
+
+      const size_t name_offset = offset + sizeof(Nhdr);
+      const size_t desc_offset = name_offset + ((namesz + 3) & ~size_t(3));
+
+      if (image.fix(note.n_type) == NT_GNU_BUILD_ID
+          && namesz == sizeof(ELF_NOTE_GNU)
+          && image.string(name_offset, namesz, 0) == ELF_NOTE_GNU) {
+        std::string id; id.reserve(descsz * 2);
+        for(size_t i = 0; i < descsz; ++i) {
+          const unsigned char c = image.load<unsigned char>(desc_offset + i);
+          id += hex[c >> 4];
+          id += hex[c & 0xf];
+        }
+        return id;
+      }
+
+      offset = desc_offset + ((descsz + 3) & ~size_t(3));
+    }
+  }
+
+  return {};
+}
+
+struct Symbol {
+  std::string_view name;
+  char type;
+  bool undefined, local;
+  long long address, size;
+};
+
+// Calls visit() for every symbol of the first table of type table_type,
+// or of .dynsym if there is none and fallback_to_dynsym is set (stripped image).
+template<typename Traits, typename Visitor>
+void visit_symbols(const Image& image, const uint32_t table_type, const bool fallback_to_dynsym, Visitor&& visit) {
+  using Shdr = typename Traits::Shdr;
+  using Sym  = typename Traits::Sym;
+
+  const std::vector<Shdr> sections = load_sections<Traits>(image);
+
+  auto find_table = [&image, &sections](const uint32_t type) -> const Shdr* {
+    for(const Shdr& section : sections)
+      if (image.fix(section.sh_type) == type)
+        return &section;
+    return nullptr;
+  };
+
+  const Shdr* table = find_table(table_type);
+  if (!table && fallback_to_dynsym)
+    table = find_table(SHT_DYNSYM);
+  if (!table)
+    return;
+
+  const size_t link = image.fix(table->sh_link);
+  if (link >= sections.size())
+    throw std::runtime_error("Invalid ELF string table link");
+
+  const size_t strtab_offset = image.fix(sections[link].sh_offset);
+  const size_t strtab_size = image.fix(sections[link].sh_size);
+
+  const size_t offset = image.fix(table->sh_offset);
+  const size_t count = image.fix(table->sh_size) / sizeof(Sym);
+
+  // The first entry is always the null symbol.
+  for(size_t i = 1; i < count; ++i) {
+    const Sym sym = image.load<Sym>(offset + i * sizeof(Sym));
+
+    const unsigned char type = ELF64_ST_TYPE(sym.st_info);
+    if (type == STT_SECTION || type == STT_FILE)
+      continue;
+
+    const std::string_view name = image.string(strtab_offset, strtab_size, image.fix(sym.st_name));
+    if (name.empty() || ignored_symbol(name))
+      continue;
+
+    const bool undefined = image.fix(sym.st_shndx) == SHN_UNDEF;
+
+    visit(Symbol{name,
+                 symbol_type<Traits>(image, sym, sections),
+                 undefined,
+                 ELF64_ST_BIND(sym.st_info) == STB_LOCAL,
+                 undefined ? -1 : static_cast<long long>(image.fix(sym.st_value)),
+                 undefined ? 0 : static_cast<long long>(image.fix(sym.st_size))});
+  }
+}
+
+Image make_image(const char* data, size_t size) {
+  if (!elf::is_elf(data, size) || size < EI_NIDENT)
+    throw std::runtime_error("Not an ELF file");
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  const bool swap = data[EI_DATA] == ELFDATA2MSB;
+#else
+  const bool swap = data[EI_DATA] == ELFDATA2LSB;
+#endif
+
+  return Image(data, size, swap);
+}
+
+template<typename Visitor>
+void visit_symbols(const char* data, size_t size, const uint32_t table_type, const bool fallback_to_dynsym, Visitor&& visit) {
+  const Image image = make_image(data, size);
+
+  switch (data[EI_CLASS]) {
+  case ELFCLASS32: visit_symbols<Elf32>(image, table_type, fallback_to_dynsym, std::forward<Visitor>(visit)); break;
+  case ELFCLASS64: visit_symbols<Elf64>(image, table_type, fallback_to_dynsym, std::forward<Visitor>(visit)); break;
+  default: throw std::runtime_error("Unsupported ELF class");
+  }
+}
+
+void emplace(SymbolReferenceSet& symbols, const Symbol& symbol) {
+  symbols.emplace(symbol.name, symbol.type, symbol.address, symbol.size);
+}
+
+} // anonymous namespace
+
+namespace elf {
+
+bool is_elf(const char* data, size_t size)
+{
+  return size >= SELFMAG && std::memcmp(data, ELFMAG, SELFMAG) == 0;
+}
+
+void read_symbols(const char* data, size_t size, SymbolReferenceSet& symbols, const int flags)
+{
+  const uint32_t table_type = (flags & nm_options::dynamic) ? SHT_DYNSYM : SHT_SYMTAB;
+
+  visit_symbols(data, size, table_type, false, [&symbols, flags](const Symbol& symbol) {
+    if ((flags & nm_options::undefined) && !symbol.undefined)
+      return;
+    if ((flags & nm_options::defined) && symbol.undefined)
+      return;
+    if ((flags & nm_options::defined_extern) && (symbol.undefined || symbol.local))
+      return;
+
+    emplace(symbols, symbol);
+  });
+}
+
+void read_symbols(const char* data, size_t size, ArtifactSymbols& symbols)
+{
+  visit_symbols(data, size, SHT_SYMTAB, true, [&symbols](const Symbol& symbol) {
+    if (symbol.undefined)
+      emplace(symbols.undefined, symbol);
+    else if (symbol.local)
+      emplace(symbols.internal, symbol);
+    else
+      emplace(symbols.external, symbol);
+  });
+}
+
+std::string build_id(const char* data, size_t size)
+{
+  const Image image = make_image(data, size);
+
+  switch (data[EI_CLASS]) {
+  case ELFCLASS32: return ::build_id<Elf32>(image);
+  case ELFCLASS64: return ::build_id<Elf64>(image);
+  default: throw std::runtime_error("Unsupported ELF class");
+  }
+}
+
+} // namespace elf
@@ -0,0 +1,31 @@
+#ifndef ELF_HXX
+#define ELF_HXX
+
+#include <cstddef>
+#include <string>
+
+#include "SymbolReferenceSet.hxx"
+
+struct ArtifactSymbols;
+
+namespace elf {
+
+bool is_elf(const char* data, size_t size);
+
+// Reads the symbols of an in-memory ELF image, selected through nm_options flags
+// (nm_options::dynamic reads .dynsym instead of .symtab).
+// Symbols are typed and filtered the same way parse_nm_output() does.
+// Throws std::runtime_error on malformed images.
+void read_symbols(const char* data, size_t size, SymbolReferenceSet& symbols, const int flags);
+
+// Reads the symbol table in a single pass, sorting each symbol by binding and section index:
+// undefined (SHN_UNDEF), external (global, weak or unique binding) or internal (local binding).
+// Falls back to .dynsym when .symtab has been stripped.
+void read_symbols(const char* data, size_t size, ArtifactSymbols& symbols);
+
+// Hexadecimal GNU build-id, empty if the image has none.
+std::string build_id(const char* data, size_t size);
+
+} // namespace elf
+
+#endif // ELF_HXX
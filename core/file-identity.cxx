@@ -0,0 +1,35 @@
+#include "file-identity.hxx"
+
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "elf.hxx"
+#include "mapped-file.hxx"
+
+bool stat_file(const std::string& path, FileIdentity& identity)
+{
+  struct stat st;
+  if (::stat(path.c_str(), &st) == -1)
+    return false;
+
+  identity.device   = static_cast<long long>(st.st_dev);
+  identity.inode    = static_cast<long long>(st.st_ino);
+  identity.size     = static_cast<long long>(st.st_size);
+  identity.mtime_ns = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+
+  return true;
+}
+
+std::string file_build_id(const std::string& path)
+{
+  try {
+    const MappedFile file(path);
+    if (elf::is_elf(file.data(), file.size()))
+      return elf::build_id(file.data(), file.size());
+  } catch (const std::exception&) {
+    // No build-id then, the extraction reports the actual error.
+  }
+
+  return {};
+}
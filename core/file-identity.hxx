@@ -0,0 +1,28 @@
+#ifndef FILEIDENTITY_HXX
+#define FILEIDENTITY_HXX
+
+#include <string>
+
+// What tells us that an artifact on disk is still the one we extracted symbols from.
+struct FileIdentity {
+  long long device = -1;
+  long long inode = -1;
+  long long size = -1;
+  long long mtime_ns = -1;
+  std::string build_id;
+
+  bool valid() const { return inode >= 0; }
+
+  // Compares what stat() returns, the build-id is only looked at when this fails.
+  bool same_file(const FileIdentity& other) const {
+    return device == other.device && inode == other.inode && size == other.size && mtime_ns == other.mtime_ns;
+  }
+};
+
+// Returns false if the file cannot be stat'ed (most likely removed).
+bool stat_file(const std::string& path, FileIdentity& identity);
+
+// Hexadecimal GNU build-id of an ELF file, empty if the file has none or is not an ELF file.
+std::string file_build_id(const std::string& path);
+
+#endif // FILEIDENTITY_HXX
@@ -0,0 +1,249 @@
+#include "json-reader.hxx"
+
+#include <stdexcept>
+
+JsonReader::JsonReader(std::istream& in)
+  : mBuffer(*in.rdbuf())
+{}
+
+int JsonReader::peek()
+{
+  return mBuffer.sgetc();
+}
+
+int JsonReader::get()
+{
+  const int c = mBuffer.sbumpc();
+  if (c == '\n')
+    ++mLine;
+  return c;
+}
+
+int JsonReader::peek_token()
+{
+  int c = peek();
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+    get();
+    c = peek();
+  }
+  return c;
+}
+
+void JsonReader::expect(char c)
+{
+  if (peek_token() != c)
+    error(std::string("expected '") + c + "'");
+  get();
+}
+
+void JsonReader::error(const std::string& message)
+{
+  const int c = peek();
+  throw std::runtime_error("Unable to parse JSON: " + message + " at line " + std::to_string(mLine)
+                           + (c == std::char_traits<char>::eof() ? std::string(", end of input") : std::string(", found '") + static_cast<char>(c) + "'"));
+}
+
+JsonReader::value_type JsonReader::next_type()
+{
+  switch (peek_token()) {
+  case '{': return value_type::object;
+  case '[': return value_type::array;
+  case '"': return value_type::string;
+  case 't':
+  case 'f': return value_type::boolean;
+  case 'n': return value_type::null;
+  case '-':
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    return value_type::number;
+  default:
+    error("expected a value");
+  }
+}
+
+void JsonReader::begin_array()
+{
+  expect('[');
+  mFirst.push_back(true);
+}
+
+void JsonReader::begin_object()
+{
+  expect('{');
+  mFirst.push_back(true);
+}
+
+bool JsonReader::next_item(char close)
+{
+  if (mFirst.empty())
+    error("no array or object is being read");
+
+  if (peek_token() == close) {
+    get();
+    mFirst.pop_back();
+    return false;
+  }
+
+  if (mFirst.back())
+    mFirst.back() = false;
+  else
+    expect(',');
+
+  return true;
+}
+
+bool JsonReader::next_element()
+{
+  return next_item(']');
+}
+
+bool JsonReader::next_member(std::string& key)
+{
+  if (!next_item('}'))
+    return false;
+
+  key = read_string();
+  expect(':');
+  return true;
+}
+
+unsigned int JsonReader::read_hex4()
+{
+  unsigned int value = 0;
+  for(int i = 0; i < 4; ++i) {
+    const int c = get();
+    value <<= 4;
+    if (c >= '0' && c <= '9')
+      value |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      value |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      value |= c - 'A' + 10;
+    else
+      error("invalid \\u escape");
+  }
+  return value;
+}
+
+void JsonReader::append_utf8(std::string& out, unsigned long code_point)
+{
+  if (code_point < 0x80) {
+    out += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    out += static_cast<char>(0xC0 | (code_point >> 6));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    out += static_cast<char>(0xE0 | (code_point >> 12));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (code_point >> 18));
+    out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+std::string JsonReader::read_string()
+{
+  expect('"');
+
+  std::string out;
+
+  for(;;) {
+    int c = get();
+
+    if (c == std::char_traits<char>::eof())
+      error("unterminated string");
+
+    if (c == '"')
+      return out;
+
+    if (c != '\\') {
+      out += static_cast<char>(c);
+      continue;
+    }
+
+    switch (c = get()) {
+    case '"':  out += '"';  break;
+    case '\\': out += '\\'; break;
+    case '/':  out += '/';  break;
+    case 'b':  out += '\b'; break;
+    case 'f':  out += '\f'; break;
+    case 'n':  out += '\n'; break;
+    case 'r':  out += '\r'; break;
+    case 't':  out += '\t'; break;
+    case 'u': {
+      unsigned long code_point = read_hex4();
+      // Characters outside of the BMP are written as a surrogate pair.
+      if (code_point >= 0xD800 && code_point < 0xDC00) {
+        if (get() != '\\' || get() != 'u')
+          error("unpaired surrogate");
+        const unsigned int low = read_hex4();
+        if (low < 0xDC00 || low >= 0xE000)
+          error("unpaired surrogate");
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+      }
+      append_utf8(out, code_point);
+      break;
+    }
+    default:
+      error("invalid escape sequence");
+    }
+  }
+}
+
+void JsonReader::read_literal(const char* literal)
+{
+  for(const char* c = literal; *c; ++c) {
+    if (peek() != *c)
+      error(std::string("expected ") + literal);
+    get();
+  }
+}
+
+void JsonReader::read_number()
+{
+  // Validated loosely, the text is not converted.
+  int c = peek();
+  while (c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E' || (c >= '0' && c <= '9')) {
+    get();
+    c = peek();
+  }
+}
+
+void JsonReader::skip_value()
+{
+  switch (next_type()) {
+  case value_type::object: {
+    begin_object();
+    std::string key;
+    while (next_member(key))
+      skip_value();
+    break;
+  }
+  case value_type::array:
+    begin_array();
+    while (next_element())
+      skip_value();
+    break;
+  case value_type::string:
+    read_string();
+    break;
+  case value_type::number:
+    read_number();
+    break;
+  case value_type::boolean:
+    read_literal(peek() == 't' ? "true" : "false");
+    break;
+  case value_type::null:
+    read_literal("null");
+    break;
+  }
+}
+
+void JsonReader::end()
+{
+  if (peek_token() != std::char_traits<char>::eof())
+    error("expected the end of input");
+}
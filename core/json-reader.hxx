@@ -0,0 +1,72 @@
+#ifndef JSONREADER_HXX
+#define JSONREADER_HXX
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// Pull parser reading JSON from a stream one token at a time, without building a tree:
+//
+//   json.begin_array();
+//   while (json.next_element()) {
+//     json.begin_object();
+//     while (json.next_member(key))
+//       key == "name" ? name = json.read_string() : json.skip_value();
+//   }
+//
+// Malformed input throws std::runtime_error with the line number.
+class JsonReader {
+public:
+  enum class value_type {
+    object,
+    array,
+    string,
+    number,
+    boolean,
+    null
+  };
+
+private:
+  std::streambuf& mBuffer;
+  size_t mLine = 1;
+
+  // One entry per array or object being read, true until its first item.
+  std::vector<bool> mFirst;
+
+  int peek();
+  int get();
+  int peek_token();
+  void expect(char c);
+  bool next_item(char close);
+  void read_literal(const char* literal);
+  void read_number();
+  void append_utf8(std::string& out, unsigned long code_point);
+  unsigned int read_hex4();
+
+  [[noreturn]] void error(const std::string& message);
+
+public:
+  explicit JsonReader(std::istream& in);
+
+  value_type next_type();
+
+  void begin_array();
+
+  // Consumes the separator before the next element, false and the closing bracket at the end of the array.
+  bool next_element();
+
+  void begin_object();
+
+  // Reads the key of the next member, false and the closing brace at the end of the object.
+  bool next_member(std::string& key);
+
+  std::string read_string();
+
+  // Skips a value of any type, nested arrays and objects included.
+  void skip_value();
+
+  // Throws if anything but white space is left.
+  void end();
+};
+
+#endif // JSONREADER_HXX
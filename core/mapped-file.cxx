@@ -0,0 +1,47 @@
+#include "mapped-file.hxx"
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path)
+  : mData(nullptr)
+  , mSize(0UL)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    throw std::system_error(errno, std::generic_category(), "Unable to open " + path);
+
+  struct stat st;
+  if (::fstat(fd, &st) == -1) {
+    const int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(), "Unable to stat " + path);
+  }
+
+  mSize = static_cast<size_t>(st.st_size);
+
+  // mmap() refuses empty mappings, an empty file is simply an empty buffer.
+  if (mSize > 0) {
+    void* addr = ::mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "Unable to map " + path);
+    }
+    mData = static_cast<const char*>(addr);
+  }
+
+  // The mapping stays valid once the descriptor is closed.
+  ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  if (mData)
+    ::munmap(const_cast<char*>(mData), mSize);
+}
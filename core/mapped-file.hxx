@@ -0,0 +1,22 @@
+#ifndef MAPPEDFILE_HXX
+#define MAPPEDFILE_HXX
+
+#include <cstddef>
+#include <string>
+
+#include <boost/core/noncopyable.hpp>
+
+class MappedFile : boost::noncopyable {
+private:
+  const char* mData;
+  size_t mSize;
+
+public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  const char* data() const { return mData; }
+  size_t size() const { return mSize; }
+};
+
+#endif // MAPPEDFILE_HXX
@@ -1,128 +1,218 @@
 #include "nm.hxx"
 
+#include <cstring>
+#include <memory>
 #include <sstream>
+#include <vector>
 
-#include <boost/process.hpp>
-
+#include <shellwords/shellwords.hxx>
 #include <instrmt/instrmt.hxx>
 
 #include "utils.hxx"
-#include "ThreadPool.hpp"
+#include "process-reactor.hxx"
 
-namespace bp = boost::process;
+std::string nm_command(const std::string& file, const int flags)
+{
+  std::string args;
 
-namespace {
+  if (flags & nm_options::undefined)
+    args = "--undefined-only";
+  else if (flags & nm_options::defined)
+    args = "-S --defined-only";
+  else if (flags & nm_options::defined_extern)
+    args = "-S --defined-only --extern-only";
 
-std::future<void> async_symbol_parser(std::istream& stream, SymbolReferenceSet& symbols)
-{
-  return std::async(std::launch::async, [&stream, &symbols](){ parse_nm_output(stream, symbols); });
+  if (flags & nm_options::dynamic)
+    args += " -D";
+
+  return "nm " + args + " \"" + file + "\"";
 }
 
-std::future<std::string> async_stream_reader(std::istream& stream)
+std::future<ProcessResult> nm(ProcessReactor& reactor, const std::string& file, const int flags, SymbolReferenceSet& symbols)
 {
-  return std::async(std::launch::async, [&stream]() { return read_stream(stream); });
-};
+  auto promise = std::make_shared<std::promise<ProcessResult>>();
+  auto result = std::make_shared<ProcessResult>();
+  auto parser = std::make_shared<NmOutputParser>(symbols);
+  result->command = nm_command(file, flags);
+
+  std::future<ProcessResult> future = promise->get_future();
+
+  reactor.spawn(shellwords::shellsplit(result->command), {},
+                [parser](std::string_view block) { parser->feed(block); },
+                [result](std::string_view block) { result->err.append(block); },
+                [promise, result, parser](int code, std::exception_ptr error) {
+    if (error) {
+      promise->set_exception(error);
+      return;
+    }
 
-} // anonymous namespace
+    parser->finish();
+    result->code = code;
+    rtrim(result->err);
+    promise->set_value(std::move(*result));
+  });
 
-ProcessResult nm(const std::string& file,
+  return future;
+}
+
+ProcessResult nm(ProcessReactor& reactor,
+                 const std::string& file,
                  SymbolReferenceSet& symbols,
-                 const std::string& options,
-                 const std::function<std::future<void>(std::istream&, SymbolReferenceSet&)>& async_parse_out,
-                 const std::function<std::future<std::string>(std::istream&)>& async_parse_err)
+                 const int flags)
 {
-  INSTRMT_FUNCTION();
+  return nm(reactor, file, flags, symbols).get();
+}
 
-  ProcessResult process;
-  process.command = "nm " + options + " \"" + file + "\"";
+bool ignored_symbol(std::string_view name)
+{
+  // Filter-out:
+  // .LC??
+  // _GLOBAL__sub_I_*.cpp
+  // symbol [clone .cold]
+  // DW.ref.__gxx_personality_v0
+  return name.find('.') != std::string_view::npos
+      || name == "__gmon_start__"
+      || name == "_ITM_";
+}
 
-  bp::ipstream out_stream, err_stream;
+namespace {
 
-  bp::child c(process.command,
-              bp::std_in.close(),
-              bp::std_out > out_stream,
-              bp::std_err > err_stream
-              );
+long long parse_hex(std::string_view str)
+{
+  unsigned long long value = 0ULL;
+  for(const char c : str) {
+    unsigned int digit;
+    if (c >= '0' && c <= '9')
+      digit = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      digit = c - 'A' + 10;
+    else
+      break;
+    value = (value << 4) | digit;
+  }
+  return static_cast<long long>(value);
+}
 
-  std::future<void> symbols_parsed = async_parse_out(out_stream, symbols);
+// Lines are either "<address> <size> <type> <name>" (defined symbols, -S)
+// or "<padding> <type> <name>" (undefined or unsized symbols).
+void parse_nm_line(std::string_view line, SymbolReferenceSet& symbols)
+{
+  long long address = -1;
+  long long sz = 0;
+  size_t offset = 17;
 
-  std::future<std::string> err_f = async_parse_err(err_stream);
+  if (line.size() <= offset + 2)
+    return;
 
-  symbols_parsed.wait();
-  process.err = err_f.get();
-  rtrim(process.err);
+  if (line[offset] >= '0' && line[offset] <= '9') {
+    address = parse_hex(line.substr(0, 16));
+    sz = parse_hex(line.substr(17, 16));
+    offset = 34;
 
-  c.wait();
+    if (line.size() <= offset + 2)
+      return;
+  }
 
-  process.code = c.exit_code();
+  const std::string_view name = line.substr(offset + 2);
+  if (ignored_symbol(name))
+    return;
 
-  return process;
+  symbols.emplace(name, line[offset], address, sz);
 }
 
-ProcessResult nm(const std::string& file,
-                 SymbolReferenceSet& symbols,
-                 const int flags,
-                 const std::function<std::future<void>(std::istream&, SymbolReferenceSet&)>& async_parse_out,
-                 const std::function<std::future<std::string>(std::istream&)>& async_parse_err)
+// Parses all the complete lines of [begin, end).
+// Returns the start of the trailing incomplete line, or nullptr once the terminating empty line is reached.
+const char* parse_nm_lines(const char* begin, const char* end, SymbolReferenceSet& symbols)
 {
-  std::string args;
+  while (begin < end) {
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (!eol)
+      return begin;
 
-  if (flags & nm_options::undefined)
-    args = "--undefined-only";
-  else if (flags & nm_options::defined)
-    args = "-S --defined-only";
-  else if (flags & nm_options::defined_extern)
-    args = "-S --defined-only --extern-only";
+    if (eol == begin)
+      return nullptr;
 
-  if (flags & nm_options::dynamic)
-    args += " -D";
+    parse_nm_line(std::string_view(begin, eol - begin), symbols);
+    begin = eol + 1;
+  }
 
-  return nm(file, symbols, args, async_parse_out, async_parse_err);
+  return begin;
 }
 
-void parse_nm_output(std::istream& stream, SymbolReferenceSet& symbols)
+} // anonymous namespace
+
+void parse_nm_output(std::string_view output, SymbolReferenceSet& symbols)
+{
+  const char* tail = parse_nm_lines(output.data(), output.data() + output.size(), symbols);
+
+  // Last line, not terminated by a newline.
+  if (tail && tail < output.data() + output.size())
+    parse_nm_line(std::string_view(tail, output.data() + output.size() - tail), symbols);
+}
+
+void NmOutputParser::feed(std::string_view block)
 {
-  std::string line;
-//  std::smatch nm_match;
-  while (stream && std::getline(stream, line) && !line.empty()) {
-    long long address = -1;
-    long long sz = 0;
-    size_t offset = 17;
-
-    if (line[offset] >= '0' && line[offset] <= '9') {
-      const std::string addr_str(line, 0, 16);
-      address = std::stoll(addr_str, nullptr, 16);
-
-      const std::string size_str(line, 17, 16);
-      sz = std::stoll(size_str, nullptr, 16);
-      offset = 34;
+  INSTRMT_FUNCTION();
+
+  if (mDone)
+    return;
+
+  const char* begin = block.data();
+  const char* end = block.data() + block.size();
+
+  // Completes the line started by the previous block.
+  if (!mPending.empty()) {
+    const char* eol = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    if (!eol) {
+      mPending.append(begin, end);
+      return;
     }
 
-    // Filter-out:
-    // .LC??
-    // _GLOBAL__sub_I_*.cpp
-    // symbol [clone .cold]
-    // DW.ref.__gxx_personality_v0
-    if (line[offset + 2] == '.' // There's a lot of .LC??
-        || memrchr(&(line[offset + 2]), '.', line.length() - offset - 2) != NULL
-        || strncmp(&(line[offset + 2]), "__gmon_start__", sizeof("__gmon_start__")) == 0
-        || strncmp(&(line[offset + 2]), "_ITM_", sizeof("_ITM_")) == 0)
-      continue;
-
-    symbols.emplace(std::string(line, offset + 2), line[offset], address, sz);
+    mPending.append(begin, eol);
+    parse_nm_line(mPending, mSymbols);
+    mPending.clear();
+    begin = eol + 1;
   }
+
+  const char* tail = parse_nm_lines(begin, end, mSymbols);
+  if (!tail)
+    mDone = true;
+  else
+    mPending.assign(tail, end);
 }
 
-std::string read_stream(std::istream& stream)
+void NmOutputParser::finish()
 {
-  std::ostringstream ss;
-  ss << stream.rdbuf();
-  return ss.str();
+  if (!mDone && !mPending.empty())
+    parse_nm_line(mPending, mSymbols);
+
+  mPending.clear();
+  mDone = true;
 }
 
-ProcessResult nm(const std::string& file,
-                 SymbolReferenceSet& symbols,
-                 const int flags)
+void parse_nm_output(std::istream& stream, SymbolReferenceSet& symbols)
 {
-  return nm(file, symbols, flags, async_symbol_parser, async_stream_reader);
+  std::vector<char> buffer(64 * 1024);
+  size_t pending = 0UL;
+
+  while (stream) {
+    if (pending == buffer.size())
+      buffer.resize(buffer.size() * 2); // Line longer than the buffer.
+
+    const std::streamsize count = stream.rdbuf()->sgetn(buffer.data() + pending, buffer.size() - pending);
+    if (count <= 0)
+      break;
+
+    const char* end = buffer.data() + pending + count;
+    const char* tail = parse_nm_lines(buffer.data(), end, symbols);
+    if (!tail)
+      return;
+
+    pending = end - tail;
+    std::memmove(buffer.data(), tail, pending);
+  }
+
+  parse_nm_output(std::string_view(buffer.data(), pending), symbols);
 }
@@ -2,22 +2,37 @@
 #define NM_HXX
 
 #include <string>
+#include <string_view>
 #include <iosfwd>
-#include <functional>
 #include <future>
 
 #include "SymbolReferenceSet.hxx"
 #include "process-utils.hxx"
 
+class ProcessReactor;
+
+bool ignored_symbol(std::string_view name);
+
 void parse_nm_output(std::istream& stream, SymbolReferenceSet& symbols);
 
-std::string read_stream(std::istream& stream);
+void parse_nm_output(std::string_view output, SymbolReferenceSet& symbols);
 
-ProcessResult nm(const std::string& file,
-                 SymbolReferenceSet& symbols,
-                 const std::string& options,
-                 const std::function<std::future<void>(std::istream&, SymbolReferenceSet&)>& async_parse_out,
-                 const std::function<std::future<std::string>(std::istream&)>& async_parse_err);
+// Parses nm output fed by blocks of any size, as read from a pipe.
+class NmOutputParser {
+private:
+  SymbolReferenceSet& mSymbols;
+  // Incomplete line at the end of the last block.
+  std::string mPending;
+  bool mDone = false;
+
+public:
+  explicit NmOutputParser(SymbolReferenceSet& symbols) : mSymbols(symbols) {}
+
+  void feed(std::string_view block);
+
+  // Parses the last line when it is not terminated by a newline.
+  void finish();
+};
 
 namespace nm_options {
   constexpr int dynamic                = 1 << 0;
@@ -29,13 +44,14 @@ namespace nm_options {
   constexpr int defined_extern_dynamic = dynamic | defined_extern;
 };
 
-ProcessResult nm(const std::string& file,
-                 SymbolReferenceSet& symbols,
-                 const int flags,
-                 const std::function<std::future<void>(std::istream&, SymbolReferenceSet&)>& async_parse_out,
-                 const std::function<std::future<std::string>(std::istream&)>& async_parse_err);
+std::string nm_command(const std::string& file, const int flags);
+
+// Starts nm, its output is parsed into symbols by the reactor thread as it is read.
+// symbols must not be used until the future is ready. The result holds stderr and the exit code.
+std::future<ProcessResult> nm(ProcessReactor& reactor, const std::string& file, const int flags, SymbolReferenceSet& symbols);
 
-ProcessResult nm(const std::string& file,
+ProcessResult nm(ProcessReactor& reactor,
+                 const std::string& file,
                  SymbolReferenceSet& symbols,
                  const int flags);
 
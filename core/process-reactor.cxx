@@ -0,0 +1,371 @@
+#include "process-reactor.hxx"
+
+#include <cerrno>
+#include <csignal>
+#include <system_error>
+#include <unordered_set>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <shellwords/shellwords.hxx>
+
+#include "utils.hxx"
+
+namespace {
+
+// Readable once the process has exited, -1 when not supported.
+int pidfd_open(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+  return static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+} // anonymous namespace
+
+ProcessReactor::ProcessReactor(size_t budget)
+  : mBudget(budget > 0 ? budget : 1)
+  , mEpoll(::epoll_create1(EPOLL_CLOEXEC))
+  , mWakeup(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+  if (mEpoll == -1 || mWakeup == -1) {
+    const int error = errno;
+    if (mEpoll != -1) ::close(mEpoll);
+    if (mWakeup != -1) ::close(mWakeup);
+    throw std::system_error(error, std::generic_category(), "Unable to create the process reactor");
+  }
+
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = mWakeup;
+  ::epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeup, &event);
+
+  // Nothing above the thread could catch an error, the jobs fail with it instead.
+  mThread = std::thread([this]{
+    try {
+      loop();
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  });
+}
+
+ProcessReactor::~ProcessReactor()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping = true;
+  }
+
+  const uint64_t one = 1;
+  (void)!::write(mWakeup, &one, sizeof(one));
+
+  mThread.join();
+
+  ::close(mWakeup);
+  ::close(mEpoll);
+}
+
+void ProcessReactor::submit(Job&& job)
+{
+  std::exception_ptr failure;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFailure)
+      failure = mFailure;
+    else
+      mQueue.emplace_back(std::move(job));
+  }
+
+  if (failure) {
+    job.done(-1, failure);
+    return;
+  }
+
+  const uint64_t one = 1;
+  (void)!::write(mWakeup, &one, sizeof(one));
+}
+
+std::future<int> ProcessReactor::spawn(std::vector<std::string> argv, std::string directory, Sink out, Sink err)
+{
+  auto promise = std::make_shared<std::promise<int>>();
+  std::future<int> future = promise->get_future();
+
+  spawn(std::move(argv), std::move(directory), std::move(out), std::move(err), [promise](int code, std::exception_ptr error) {
+    if (error)
+      promise->set_exception(error);
+    else
+      promise->set_value(code);
+  });
+
+  return future;
+}
+
+void ProcessReactor::spawn(std::vector<std::string> argv, std::string directory, Sink out, Sink err,
+                           std::function<void(int, std::exception_ptr)> done)
+{
+  Job job;
+  job.argv = std::move(argv);
+  job.directory = std::move(directory);
+  job.out = std::move(out);
+  job.err = std::move(err);
+  job.done = std::move(done);
+
+  submit(std::move(job));
+}
+
+std::future<ProcessResult> ProcessReactor::run(const std::string& command, const std::string& directory)
+{
+  return run(shellwords::shellsplit(command), directory);
+}
+
+std::future<ProcessResult> ProcessReactor::run(std::vector<std::string> argv, std::string directory)
+{
+  auto promise = std::make_shared<std::promise<ProcessResult>>();
+  auto result = std::make_shared<ProcessResult>();
+  result->command = shell_join(argv);
+
+  std::future<ProcessResult> future = promise->get_future();
+
+  Job job;
+  job.argv = std::move(argv);
+  job.directory = std::move(directory);
+  job.out = [result](std::string_view buffer) { result->out.append(buffer); };
+  job.err = [result](std::string_view buffer) { result->err.append(buffer); };
+  job.done = [promise, result](int code, std::exception_ptr error) {
+    if (error) {
+      promise->set_exception(error);
+    } else {
+      result->code = code;
+      promise->set_value(std::move(*result));
+    }
+  };
+
+  submit(std::move(job));
+
+  return future;
+}
+
+void ProcessReactor::loop()
+{
+  struct epoll_event events[64];
+
+  for(;;) {
+    start_queued();
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (mStopping && mQueue.empty() && mRunning == 0)
+        return;
+    }
+
+    const int n = ::epoll_wait(mEpoll, events, sizeof(events) / sizeof(events[0]), mPolled.empty() ? -1 : 10);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      throw std::system_error(errno, std::generic_category(), "epoll_wait failed");
+    }
+
+    for(size_t i = 0; i < mPolled.size(); ) {
+      // Copy, reap() may finish the job.
+      const std::shared_ptr<Running> running = mPolled[i];
+      if (reap(running))
+        mPolled.erase(mPolled.begin() + static_cast<std::ptrdiff_t>(i));
+      else
+        ++i;
+    }
+
+    for(int i = 0; i < n; ++i) {
+      const int fd = events[i].data.fd;
+
+      if (fd == mWakeup) {
+        uint64_t count;
+        (void)!::read(mWakeup, &count, sizeof(count));
+        continue;
+      }
+
+      const auto it = mDescriptors.find(fd);
+      if (it == mDescriptors.end())
+        continue;
+
+      // Copy, drain() and reap() may erase the map entry.
+      const std::shared_ptr<Running> running = it->second;
+      if (fd == running->pidfd)
+        reap(running);
+      else
+        drain(fd, running, fd == running->process->out());
+    }
+  }
+}
+
+void ProcessReactor::fail(std::exception_ptr error)
+{
+  std::deque<Job> queued;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFailure = error;
+    queued.swap(mQueue);
+  }
+
+  std::unordered_set<std::shared_ptr<Running>> running(mPolled.begin(), mPolled.end());
+  for(const auto& descriptor : mDescriptors)
+    running.insert(descriptor.second);
+
+  mDescriptors.clear();
+  mPolled.clear();
+  mRunning = 0;
+
+  for(const std::shared_ptr<Running>& job : running) {
+    if (job->pidfd != -1)
+      ::close(job->pidfd);
+
+    // Nothing drains its pipes anymore, the destructor of Process would wait for it forever.
+    if (job->process) {
+      ::kill(job->process->pid(), SIGKILL);
+      job->process.reset();
+    }
+
+    job->job.done(-1, error);
+  }
+
+  for(Job& job : queued)
+    job.done(-1, error);
+}
+
+void ProcessReactor::start_queued()
+{
+  while (mRunning < mBudget) {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (mQueue.empty())
+        return;
+      job = std::move(mQueue.front());
+      mQueue.pop_front();
+    }
+
+    start(std::move(job));
+  }
+}
+
+void ProcessReactor::start(Job&& job)
+{
+  auto running = std::make_shared<Running>();
+  running->job = std::move(job);
+
+  try {
+    running->process = std::make_unique<Process>(running->job.argv,
+                                                 running->job.directory,
+                                                 running->job.out ? Process::output::pipe : Process::output::null,
+                                                 running->job.err ? Process::output::pipe : Process::output::null);
+  } catch (...) {
+    running->job.done(-1, std::current_exception());
+    return;
+  }
+
+  ++mRunning;
+
+  for(const int fd : {running->process->out(), running->process->err()}) {
+    if (fd == -1)
+      continue;
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    ::epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event);
+
+    mDescriptors.emplace(fd, running);
+    ++running->open_pipes;
+  }
+
+  // The child is reaped when it exits, a blocking waitpid() would stall every other job.
+  running->pidfd = pidfd_open(running->process->pid());
+  if (running->pidfd != -1) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = running->pidfd;
+    ::epoll_ctl(mEpoll, EPOLL_CTL_ADD, running->pidfd, &event);
+
+    mDescriptors.emplace(running->pidfd, running);
+  } else {
+    mPolled.push_back(running);
+  }
+}
+
+void ProcessReactor::drain(int fd, const std::shared_ptr<Running>& running, const bool out)
+{
+  char buffer[64 * 1024];
+
+  ssize_t n;
+  do {
+    n = ::read(fd, buffer, sizeof(buffer));
+  } while (n == -1 && errno == EINTR);
+
+  if (n > 0) {
+    // A failing sink does not stop the child, its output is drained and dropped.
+    if (!running->error) {
+      try {
+        (out ? running->job.out : running->job.err)(std::string_view(buffer, static_cast<size_t>(n)));
+      } catch (...) {
+        running->error = std::current_exception();
+      }
+    }
+    return;
+  }
+
+  ::epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+  mDescriptors.erase(fd);
+
+  if (--running->open_pipes == 0 && running->exited)
+    finish(running);
+}
+
+bool ProcessReactor::reap(const std::shared_ptr<Running>& running)
+{
+  try {
+    if (!running->process->try_wait())
+      return false;
+  } catch (...) {
+    if (!running->error)
+      running->error = std::current_exception();
+  }
+
+  if (running->pidfd != -1) {
+    ::epoll_ctl(mEpoll, EPOLL_CTL_DEL, running->pidfd, nullptr);
+    mDescriptors.erase(running->pidfd);
+    ::close(running->pidfd);
+    running->pidfd = -1;
+  }
+
+  running->exited = true;
+
+  // Pipes still held open by grandchildren are drained before the job completes.
+  if (running->open_pipes == 0)
+    finish(running);
+
+  return true;
+}
+
+void ProcessReactor::finish(const std::shared_ptr<Running>& running)
+{
+  // The child is reaped and both pipes are closed, wait() does not block.
+  int code = -1;
+  try {
+    code = running->process->wait();
+  } catch (...) {
+    if (!running->error)
+      running->error = std::current_exception();
+  }
+
+  running->process.reset();
+  --mRunning;
+
+  running->job.done(code, running->error);
+}
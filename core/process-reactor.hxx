@@ -0,0 +1,92 @@
+#ifndef PROCESSREACTOR_HXX
+#define PROCESSREACTOR_HXX
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/core/noncopyable.hpp>
+
+#include "process-utils.hxx"
+
+// Runs child processes, drains all their pipes and reaps them from a single epoll thread.
+// At most `budget` children run at the same time, the others wait in a queue.
+class ProcessReactor : boost::noncopyable {
+public:
+  // Called from the reactor thread with each buffer read from a pipe.
+  using Sink = std::function<void(std::string_view)>;
+
+private:
+  struct Job {
+    std::vector<std::string> argv;
+    std::string directory;
+    Sink out, err;
+    std::function<void(int, std::exception_ptr)> done;
+  };
+
+  struct Running {
+    std::unique_ptr<Process> process;
+    Job job;
+    size_t open_pipes = 0;
+    int pidfd = -1;
+    bool exited = false;
+    std::exception_ptr error;
+  };
+
+  const size_t mBudget;
+  int mEpoll, mWakeup;
+
+  std::mutex mMutex;
+  std::deque<Job> mQueue;
+  bool mStopping = false;
+  // Set when the reactor thread failed, the jobs submitted afterwards fail with it.
+  std::exception_ptr mFailure;
+
+  // Only touched by the reactor thread.
+  // Pipes and pidfds of the running children.
+  std::unordered_map<int, std::shared_ptr<Running>> mDescriptors;
+  // Children without a pidfd (kernels before 5.3), polled with waitpid(WNOHANG).
+  std::vector<std::shared_ptr<Running>> mPolled;
+  size_t mRunning = 0;
+
+  std::thread mThread;
+
+  void loop();
+  void start_queued();
+  void start(Job&& job);
+  void drain(int fd, const std::shared_ptr<Running>& running, const bool out);
+  bool reap(const std::shared_ptr<Running>& running);
+  void finish(const std::shared_ptr<Running>& running);
+  void submit(Job&& job);
+  void fail(std::exception_ptr error);
+
+public:
+  explicit ProcessReactor(size_t budget);
+
+  // Lets the submitted processes complete.
+  ~ProcessReactor();
+
+  size_t budget() const { return mBudget; }
+
+  // Exit code as returned by Process::wait(). Pipes not given a sink go to /dev/null.
+  std::future<int> spawn(std::vector<std::string> argv, std::string directory, Sink out, Sink err);
+
+  // Same, done() is called from the reactor thread once the sinks have received all the output.
+  void spawn(std::vector<std::string> argv, std::string directory, Sink out, Sink err,
+             std::function<void(int, std::exception_ptr)> done);
+
+  // Collects both outputs, for commands parsed once complete.
+  std::future<ProcessResult> run(std::vector<std::string> argv, std::string directory = {});
+
+  // Same, command is split by shellwords.
+  std::future<ProcessResult> run(const std::string& command, const std::string& directory = {});
+};
+
+#endif // PROCESSREACTOR_HXX
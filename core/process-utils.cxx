@@ -0,0 +1,297 @@
+#include "process-utils.hxx"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <shellwords/shellwords.hxx>
+
+extern char** environ;
+
+namespace {
+
+std::atomic<size_t> spawn_count(0);
+std::atomic<long long> spawn_total_ns(0);
+std::atomic<long long> spawn_max_ns(0);
+
+void record_spawn(const std::chrono::nanoseconds latency)
+{
+  ++spawn_count;
+  spawn_total_ns += latency.count();
+
+  long long max = spawn_max_ns.load();
+  while (latency.count() > max && !spawn_max_ns.compare_exchange_weak(max, latency.count()));
+}
+
+void close_fd(int& fd)
+{
+  if (fd != -1) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+class SpawnFileActions : boost::noncopyable {
+public:
+  posix_spawn_file_actions_t actions;
+
+  SpawnFileActions() { posix_spawn_file_actions_init(&actions); }
+  ~SpawnFileActions() { posix_spawn_file_actions_destroy(&actions); }
+};
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAVE_SPAWN_ADDCHDIR 1
+#endif
+
+#ifndef HAVE_SPAWN_ADDCHDIR
+// Without posix_spawn_file_actions_addchdir_np(), vfork() is the next best thing:
+// the child shares the parent memory until it execs.
+pid_t vfork_exec(char* const* argv, const std::string& directory, const int out_fd, const int err_fd)
+{
+  const pid_t pid = ::vfork();
+  if (pid == 0) {
+    const int null_fd = ::open("/dev/null", O_RDWR | O_CLOEXEC);
+    ::dup2(null_fd, STDIN_FILENO);
+    ::dup2(out_fd != -1 ? out_fd : null_fd, STDOUT_FILENO);
+    ::dup2(err_fd != -1 ? err_fd : null_fd, STDERR_FILENO);
+    if (::chdir(directory.c_str()) == 0)
+      ::execvp(argv[0], argv);
+    ::_exit(127);
+  }
+  return pid;
+}
+#endif
+
+} // anonymous namespace
+
+Process::Process(const std::vector<std::string>& argv, const std::string& directory, output out, output err)
+  : mPid(-1)
+  , mOut(-1)
+  , mErr(-1)
+  , mExitCode(-1)
+  , mWaited(false)
+{
+  spawn(argv, directory, out, err);
+}
+
+Process::Process(const std::string& command, const std::string& directory, output out, output err)
+  : Process(shellwords::shellsplit(command), directory, out, err)
+{}
+
+void Process::spawn(const std::vector<std::string>& argv, const std::string& directory, output out, output err)
+{
+  if (argv.empty())
+    throw std::system_error(EINVAL, std::generic_category(), "Empty command");
+
+  std::vector<char*> args; args.reserve(argv.size() + 1);
+  for(const std::string& arg : argv)
+    args.push_back(const_cast<char*>(arg.c_str()));
+  args.push_back(nullptr);
+
+  // Parent ends are close-on-exec so that concurrently spawned children do not inherit them.
+  int out_pipe[2] = {-1, -1};
+  int err_pipe[2] = {-1, -1};
+
+  auto cleanup = [&]{
+    for(int* fd : {&out_pipe[0], &out_pipe[1], &err_pipe[0], &err_pipe[1]})
+      close_fd(*fd);
+  };
+
+  if ((out == output::pipe && ::pipe2(out_pipe, O_CLOEXEC) == -1)
+      || (err == output::pipe && ::pipe2(err_pipe, O_CLOEXEC) == -1)) {
+    const int error = errno;
+    cleanup();
+    throw std::system_error(error, std::generic_category(), "Unable to create pipe for " + argv[0]);
+  }
+
+  int error = 0;
+  const auto start = std::chrono::steady_clock::now();
+
+#ifndef HAVE_SPAWN_ADDCHDIR
+  if (!directory.empty()) {
+    mPid = vfork_exec(args.data(), directory, out_pipe[1], err_pipe[1]);
+    if (mPid == -1)
+      error = errno;
+  } else
+#endif
+  {
+    SpawnFileActions fa;
+    posix_spawn_file_actions_addopen(&fa.actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+    if (out == output::pipe)
+      posix_spawn_file_actions_adddup2(&fa.actions, out_pipe[1], STDOUT_FILENO);
+    else
+      posix_spawn_file_actions_addopen(&fa.actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    if (err == output::pipe)
+      posix_spawn_file_actions_adddup2(&fa.actions, err_pipe[1], STDERR_FILENO);
+    else
+      posix_spawn_file_actions_addopen(&fa.actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+#ifdef HAVE_SPAWN_ADDCHDIR
+    if (!directory.empty())
+      posix_spawn_file_actions_addchdir_np(&fa.actions, directory.c_str());
+#endif
+
+    error = ::posix_spawnp(&mPid, args[0], &fa.actions, nullptr, args.data(), environ);
+  }
+
+  record_spawn(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start));
+
+  // Write ends belong to the child now.
+  close_fd(out_pipe[1]);
+  close_fd(err_pipe[1]);
+
+  if (error != 0) {
+    mPid = -1;
+    cleanup();
+    throw std::system_error(error, std::generic_category(), "Unable to start " + argv[0]);
+  }
+
+  mOut = out_pipe[0];
+  mErr = err_pipe[0];
+}
+
+Process::~Process()
+{
+  // Closing first: a child still writing gets SIGPIPE instead of blocking forever.
+  close_fd(mOut);
+  close_fd(mErr);
+
+  if (!mWaited && mPid > 0) {
+    int status;
+    while (::waitpid(mPid, &status, 0) == -1 && errno == EINTR);
+  }
+}
+
+void Process::communicate(std::string* out, std::string* err)
+{
+  struct pollfd fds[2];
+  std::string* sinks[2] = {out, err};
+  nfds_t count = 0;
+
+  for(const int fd : {mOut, mErr}) {
+    fds[count].fd = fd; // poll() ignores negative descriptors
+    fds[count].events = POLLIN;
+    ++count;
+  }
+
+  char buffer[64 * 1024];
+  size_t open = (mOut != -1) + (mErr != -1);
+
+  while (open > 0) {
+    if (::poll(fds, count, -1) == -1) {
+      if (errno == EINTR)
+        continue;
+      throw std::system_error(errno, std::generic_category(), "Unable to poll child process pipes");
+    }
+
+    for(nfds_t i = 0; i < count; ++i) {
+      if (fds[i].fd < 0 || fds[i].revents == 0)
+        continue;
+
+      const ssize_t n = ::read(fds[i].fd, buffer, sizeof(buffer));
+      if (n > 0) {
+        if (sinks[i])
+          sinks[i]->append(buffer, static_cast<size_t>(n));
+      } else if (n == 0 || errno != EINTR) {
+        fds[i].fd = -1;
+        --open;
+      }
+    }
+  }
+}
+
+int Process::wait()
+{
+  if (mWaited)
+    return mExitCode;
+
+  int status = 0;
+  while (::waitpid(mPid, &status, 0) == -1) {
+    if (errno != EINTR)
+      throw std::system_error(errno, std::generic_category(), "Unable to wait for child process");
+  }
+
+  set_status(status);
+  return mExitCode;
+}
+
+bool Process::try_wait()
+{
+  if (mWaited)
+    return true;
+
+  int status = 0;
+  pid_t pid;
+  while ((pid = ::waitpid(mPid, &status, WNOHANG)) == -1) {
+    if (errno != EINTR)
+      throw std::system_error(errno, std::generic_category(), "Unable to wait for child process");
+  }
+
+  if (pid == 0)
+    return false;
+
+  set_status(status);
+  return true;
+}
+
+void Process::set_status(int status)
+{
+  mWaited = true;
+
+  if (WIFEXITED(status))
+    mExitCode = WEXITSTATUS(status);
+  else if (WIFSIGNALED(status))
+    mExitCode = 128 + WTERMSIG(status);
+}
+
+PipeStream::Buffer::Buffer(int fd)
+  : mFd(fd)
+  , mBuffer(64 * 1024)
+{
+  setg(mBuffer.data(), mBuffer.data(), mBuffer.data());
+}
+
+PipeStream::Buffer::int_type PipeStream::Buffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  if (mFd == -1)
+    return traits_type::eof();
+
+  ssize_t n;
+  do {
+    n = ::read(mFd, mBuffer.data(), mBuffer.size());
+  } while (n == -1 && errno == EINTR);
+
+  if (n <= 0)
+    return traits_type::eof();
+
+  setg(mBuffer.data(), mBuffer.data(), mBuffer.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+PipeStream::PipeStream(int fd)
+  : std::istream(nullptr)
+  , mBuffer(fd)
+{
+  rdbuf(&mBuffer);
+}
+
+SpawnStats spawn_stats()
+{
+  SpawnStats stats;
+  stats.count = spawn_count.load();
+  stats.total = std::chrono::nanoseconds(spawn_total_ns.load());
+  stats.max = std::chrono::nanoseconds(spawn_max_ns.load());
+  return stats;
+}
@@ -1,7 +1,15 @@
 #ifndef PROCESSUTILS_HXX
 #define PROCESSUTILS_HXX
 
+#include <chrono>
+#include <istream>
+#include <streambuf>
 #include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/core/noncopyable.hpp>
 
 struct ProcessResult {
   std::string command;
@@ -14,4 +22,84 @@ inline bool failed(const ProcessResult& process)
   return process.code != 0 || !process.err.empty();
 }
 
+// Child process started with posix_spawn(), which does not copy the page tables
+// of the parent the way fork() does. stdin is always /dev/null.
+class Process : boost::noncopyable {
+public:
+  enum class output {
+    pipe,
+    null
+  };
+
+private:
+  pid_t mPid;
+  int mOut, mErr;
+  int mExitCode;
+  bool mWaited;
+
+  void spawn(const std::vector<std::string>& argv, const std::string& directory, output out, output err);
+  void set_status(int status);
+
+public:
+  // The executable is looked up in PATH. Throws std::system_error if it cannot be started.
+  explicit Process(const std::vector<std::string>& argv,
+                   const std::string& directory = {},
+                   output out = output::pipe,
+                   output err = output::pipe);
+
+  // Command line split with shell quoting rules, no shell is involved.
+  explicit Process(const std::string& command,
+                   const std::string& directory = {},
+                   output out = output::pipe,
+                   output err = output::pipe);
+
+  // Closes the pipes and reaps the child if wait() was not called.
+  ~Process();
+
+  pid_t pid() const { return mPid; }
+
+  // Read ends of the pipes, -1 when redirected to /dev/null.
+  int out() const { return mOut; }
+  int err() const { return mErr; }
+
+  // Reads both pipes until the child closes them.
+  void communicate(std::string* out, std::string* err);
+
+  // Exit code, or 128 + signal number if the child was killed. The pipes stay readable.
+  int wait();
+
+  // Reaps the child if it has exited, without blocking. wait() then returns its exit code.
+  bool try_wait();
+};
+
+// Reads a file descriptor it does not own.
+class PipeStream : public std::istream {
+private:
+  class Buffer : public std::streambuf {
+  private:
+    int mFd;
+    std::vector<char> mBuffer;
+
+  protected:
+    int_type underflow() override;
+
+  public:
+    explicit Buffer(int fd);
+  };
+
+  Buffer mBuffer;
+
+public:
+  explicit PipeStream(int fd);
+};
+
+struct SpawnStats {
+  size_t count = 0;
+  std::chrono::nanoseconds total{0};
+  std::chrono::nanoseconds max{0};
+};
+
+// Time spent in posix_spawn() by every Process since the program started.
+SpawnStats spawn_stats();
+
 #endif // PROCESSUTILS_HXX
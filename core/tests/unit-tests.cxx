@@ -2,6 +2,8 @@
 
 #include <filesystem>
 #include <fstream>
+#include <sstream>
+#include <thread>
 #include <stdio.h>
 #include <string.h>
 
@@ -9,9 +11,22 @@
 
 #include <boost/program_options.hpp>
 
+#include <SQLiteCpp/Transaction.h>
+
 #include "command-utils.hxx"
 #include "utils.hxx"
 #include "nm.hxx"
+#include "elf.hxx"
+#include "mapped-file.hxx"
+#include "file-identity.hxx"
+#include "archive.hxx"
+#include "process-utils.hxx"
+#include "process-reactor.hxx"
+#include "bounded-queue.hxx"
+#include "ArtifactSymbols.hxx"
+#include "Database2.hxx"
+#include "connection-pool.hxx"
+#include "database-utils.hxx"
 
 namespace fs = std::filesystem;
 
@@ -80,6 +95,77 @@ TEST(elfxplore, parse_command) {
   }
 }
 
+TEST(elfxplore, command_argv) {
+  EXPECT_THAT(decode_argv(encode_argv({"-DA=\"b c\"", "", std::string("x\0y", 3)})),
+              ::testing::ElementsAre("-DA=\"b c\"", "", std::string_view("x\0y", 3)));
+  EXPECT_TRUE(decode_argv(encode_argv({})).empty());
+  EXPECT_THROW(decode_argv(std::string_view("\x05\0\0\0ab", 6)), std::runtime_error);
+
+  CompilationCommand command;
+  parse_command(R"(/some/directory gcc '-DNAME="a b"' -o object.o -c source.c)", command, parse_command_options::with_directory);
+
+  EXPECT_THAT(command.arguments(), ::testing::ElementsAre(R"(-DNAME="a b")", "-o", "object.o", "-c", "source.c"));
+  EXPECT_THAT(redirect_gcc_output(command, "/tmp/out dir/o.o"),
+              ::testing::ElementsAre("gcc", R"(-DNAME="a b")", "-o", "/tmp/out dir/o.o", "-c", "source.c"));
+  EXPECT_THAT(redirect_gcc_output(command), ::testing::ElementsAre("gcc", R"(-DNAME="a b")", "-c", "source.c"));
+
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+  const std::string file = (dir / "db.sqlite").string();
+
+  {
+    // Schema version 1, the arguments were split on every read.
+    SQLite::Database db(file, SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+    db.exec(R"(
+create table "commands" ("id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "directory" VARCHAR(256) NOT NULL, "executable" VARCHAR(256) NOT NULL, "args" TEXT NOT NULL);
+insert into commands (directory, executable, args) values ("/", "ar", "qc 'lib a.a' a.o");
+PRAGMA user_version=1;
+)");
+  }
+
+  Database2 db(file);
+
+  auto stm = db.statement("select argv from commands where id = 1");
+  ASSERT_TRUE(stm.executeStep());
+  const std::string argv = stm.getColumn(0).getString();
+  EXPECT_THAT(decode_argv(argv), ::testing::ElementsAre("qc", "lib a.a", "a.o"));
+
+  CompilationCommand ar;
+  ar.executable = "ar";
+  ar.argv = argv;
+  EXPECT_THAT(redirect_ar_output(ar, "/tmp/b.a"), ::testing::ElementsAre("ar", "qc", "/tmp/b.a", "lib a.a", "a.o"));
+}
+
+TEST(elfxplore, expand_path) {
+  const fs::path dir = fs::canonical(create_temporary_directory());
+  const FileSystemGuard g(dir);
+
+  fs::create_directory(dir / "real");
+  std::ofstream(dir / "real" / "a.o");
+  fs::create_directory_symlink("real", dir / "link");
+  fs::create_symlink("real/a.o", dir / "b.o");
+
+  const PathCacheStats before = path_cache_stats();
+
+  EXPECT_EQ(expand_path("link/a.o", dir), dir / "real" / "a.o");
+  EXPECT_EQ(expand_path("link/../real/./a.o", dir), dir / "real" / "a.o");
+  EXPECT_EQ(expand_path("b.o", dir), dir / "real" / "a.o");
+  EXPECT_EQ(expand_path((dir / "link").string(), "/"), dir / "real");
+  EXPECT_EQ(expand_path("link/a.o", dir), dir / "real" / "a.o");
+
+  const PathCacheStats after = path_cache_stats();
+  EXPECT_EQ(after.misses - before.misses, 4UL);
+  EXPECT_EQ(after.hits - before.hits, 1UL);
+
+  // Not cached until it exists.
+  EXPECT_THROW(expand_path("link/c.o", dir), fs::filesystem_error);
+  std::ofstream(dir / "real" / "c.o");
+  EXPECT_EQ(expand_path("link/c.o", dir), dir / "real" / "c.o");
+
+  setenv("ELFXPLORE_TEST_DIR", dir.c_str(), 1);
+  EXPECT_EQ(expand_path("$ELFXPLORE_TEST_DIR/link", "/"), dir / "real");
+}
+
 void PrintTo(const SymbolReference& symbol, std::ostream* os) {
   *os << '{' << symbol.address << ' ' << symbol.type << ' ' << symbol.name << ' ' << symbol.size << '}';
 }
@@ -130,9 +216,12 @@ int c() { return a(); }
   ASSERT_EQ(system(cmd_a.c_str()), 0);
   ASSERT_EQ(system(cmd_b.c_str()), 0);
 
+  // Shared by every listing.
+  ProcessReactor reactor(2);
+
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::undefined);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::undefined);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ContainsSymbol("a"));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -141,7 +230,7 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("a")));
     EXPECT_THAT(symbols, ContainsSymbol("b"));
@@ -150,7 +239,7 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined_extern);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined_extern);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("a")));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -159,7 +248,7 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::undefined_dynamic);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::undefined_dynamic);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ContainsSymbol("a"));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -168,7 +257,7 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined_dynamic);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined_dynamic);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("a")));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -177,7 +266,7 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined_extern_dynamic);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined_extern_dynamic);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("a")));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -189,28 +278,28 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::undefined);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::undefined);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::IsEmpty());
   }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::IsEmpty());
   }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined_extern);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined_extern);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::IsEmpty());
   }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::undefined_dynamic);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::undefined_dynamic);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ContainsSymbol("a"));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -219,7 +308,7 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined_dynamic);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined_dynamic);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("a")));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
@@ -228,10 +317,681 @@ int c() { return a(); }
 
   {
     SymbolReferenceSet symbols;
-    ProcessResult result = nm(b_so.string(), symbols, nm_options::defined_extern_dynamic);
+    ProcessResult result = nm(reactor, b_so.string(), symbols, nm_options::defined_extern_dynamic);
     EXPECT_EQ(result.code, 0);
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("a")));
     EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
     EXPECT_THAT(symbols, ContainsSymbol("c"));
   }
 }
+
+TEST(elfxplore, symbol_hname) {
+  EXPECT_EQ(demangle("_ZN9namespace5Class8functionEv"), "namespace::Class::function()");
+  EXPECT_EQ(demangle("main"), "");
+
+  EXPECT_EQ(symbol_hname("_ZN1a1bEv", "a::b()"), "a::b()");
+  EXPECT_EQ(symbol_hname("_ZN1a1bEv", ""), "a::b()");
+
+  // Not a mangled name even if __cxa_demangle() accepts it as a type.
+  EXPECT_EQ(symbol_hname("a", ""), "a");
+}
+
+TEST(elfxplore, elf) {
+  const fs::path dir = create_temporary_directory();
+
+  const FileSystemGuard g(dir);
+  const fs::path a_c = dir / "a.c";
+  const fs::path b_c = dir / "b.c";
+  const fs::path a_so = dir / "liba.so";
+  const fs::path b_so = dir / "libb.so";
+
+  write_file(a_c, "int a() { return 0; }");
+  write_file(b_c, R"(
+int a();
+static int b() { return a(); }
+int c() { return a(); }
+)");
+
+  const std::string cmd_a = "gcc -shared -o " + a_so.string() + " " + a_c.string();
+  const std::string cmd_b = "gcc -shared -o " + b_so.string() + " -L" + dir.string() + " -la " + b_c.string();
+
+  ASSERT_EQ(system(cmd_a.c_str()), 0);
+  ASSERT_EQ(system(cmd_b.c_str()), 0);
+
+  // Shared by every listing.
+  ProcessReactor reactor(2);
+
+  auto names = [](const SymbolReferenceSet& symbols) {
+    std::set<std::pair<std::string, char>> out;
+    for(const SymbolReference& symbol : symbols)
+      out.emplace(symbol.name, symbol.type);
+    return out;
+  };
+
+  // Must list the same symbols as nm, with the same types.
+  for(const int flags : {nm_options::undefined, nm_options::defined, nm_options::defined_extern,
+                         nm_options::undefined_dynamic, nm_options::defined_dynamic, nm_options::defined_extern_dynamic}) {
+    SymbolReferenceSet expected;
+    ASSERT_EQ(nm(reactor, b_so.string(), expected, flags).code, 0);
+
+    const MappedFile file(b_so.string());
+    SymbolReferenceSet symbols;
+    elf::read_symbols(file.data(), file.size(), symbols, flags);
+
+    EXPECT_EQ(names(symbols), names(expected)) << "flags: " << flags;
+  }
+
+  {
+    const MappedFile file(b_so.string());
+    SymbolReferenceSet symbols;
+    elf::read_symbols(file.data(), file.size(), symbols, nm_options::defined);
+    EXPECT_THAT(symbols, ContainsSymbol("b"));
+    EXPECT_THAT(symbols, ContainsSymbol("c"));
+  }
+
+  const std::string strip_cmd = "strip -s " + b_so.string();
+  ASSERT_EQ(system(strip_cmd.c_str()), 0);
+
+  {
+    const MappedFile file(b_so.string());
+    SymbolReferenceSet symbols;
+    elf::read_symbols(file.data(), file.size(), symbols, nm_options::defined);
+    EXPECT_THAT(symbols, ::testing::IsEmpty());
+
+    elf::read_symbols(file.data(), file.size(), symbols, nm_options::defined_extern_dynamic);
+    EXPECT_THAT(symbols, ContainsSymbol("c"));
+    EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
+  }
+
+  {
+    char not_elf[] = "/* GNU ld script */";
+    EXPECT_FALSE(elf::is_elf(not_elf, sizeof(not_elf)));
+
+    SymbolReferenceSet symbols;
+    EXPECT_THROW(elf::read_symbols(not_elf, sizeof(not_elf), symbols, nm_options::defined), std::runtime_error);
+  }
+}
+
+TEST(elfxplore, elf_single_pass) {
+  const fs::path dir = create_temporary_directory();
+
+  const FileSystemGuard g(dir);
+  const fs::path b_c = dir / "b.c";
+  const fs::path b_so = dir / "libb.so";
+
+  write_file(b_c, R"(
+int a();
+static int b() { return a(); }
+int c() { return b(); }
+)");
+
+  const std::string cmd_b = "gcc -shared -o " + b_so.string() + " " + b_c.string();
+  ASSERT_EQ(system(cmd_b.c_str()), 0);
+
+  {
+    const MappedFile file(b_so.string());
+    ArtifactSymbols symbols;
+    elf::read_symbols(file.data(), file.size(), symbols);
+
+    EXPECT_THAT(symbols.undefined, ContainsSymbol("a"));
+    EXPECT_THAT(symbols.internal, ContainsSymbol("b"));
+    EXPECT_THAT(symbols.external, ContainsSymbol("c"));
+    EXPECT_THAT(symbols.external, ::testing::Not(ContainsSymbol("b")));
+    EXPECT_THAT(symbols.internal, ::testing::Not(ContainsSymbol("c")));
+  }
+
+  const std::string strip_cmd = "strip -s " + b_so.string();
+  ASSERT_EQ(system(strip_cmd.c_str()), 0);
+
+  // Stripped: .dynsym is used instead, local symbols are gone.
+  {
+    const MappedFile file(b_so.string());
+    ArtifactSymbols symbols;
+    elf::read_symbols(file.data(), file.size(), symbols);
+
+    EXPECT_THAT(symbols.undefined, ContainsSymbol("a"));
+    EXPECT_THAT(symbols.internal, ::testing::Not(ContainsSymbol("b")));
+    EXPECT_THAT(symbols.external, ContainsSymbol("c"));
+  }
+}
+
+TEST(elfxplore, file_identity) {
+  const fs::path dir = create_temporary_directory();
+
+  const FileSystemGuard g(dir);
+  const fs::path a_c = dir / "a.c";
+  const fs::path a_so = dir / "liba.so";
+  const fs::path a_o = dir / "a.o";
+
+  write_file(a_c, "int a() { return 0; }");
+
+  const std::string cmd_so = "gcc -shared -Wl,--build-id=sha1 -o " + a_so.string() + " " + a_c.string();
+  const std::string cmd_o = "gcc -c -o " + a_o.string() + " " + a_c.string();
+  ASSERT_EQ(system(cmd_so.c_str()), 0);
+  ASSERT_EQ(system(cmd_o.c_str()), 0);
+
+  FileIdentity before;
+  ASSERT_TRUE(stat_file(a_so.string(), before));
+  EXPECT_TRUE(before.valid());
+
+  // readelf prints the same hexadecimal form.
+  const std::string build_id = file_build_id(a_so.string());
+  EXPECT_EQ(build_id.size(), 40UL);
+  const std::string readelf_cmd = "readelf -n " + a_so.string() + " | grep -q 'Build ID: " + build_id + "'";
+  EXPECT_EQ(system(readelf_cmd.c_str()), 0);
+
+  EXPECT_EQ(file_build_id(a_o.string()), "");
+  EXPECT_EQ(file_build_id(a_c.string()), "");
+
+  FileIdentity same;
+  ASSERT_TRUE(stat_file(a_so.string(), same));
+  EXPECT_TRUE(before.same_file(same));
+
+  // Relinking gives a new inode/mtime but the same build-id.
+  ASSERT_EQ(system(("rm " + a_so.string() + " && " + cmd_so).c_str()), 0);
+  FileIdentity after;
+  ASSERT_TRUE(stat_file(a_so.string(), after));
+  EXPECT_FALSE(before.same_file(after));
+  EXPECT_EQ(file_build_id(a_so.string()), build_id);
+
+  FileIdentity missing;
+  EXPECT_FALSE(stat_file((dir / "missing.so").string(), missing));
+  EXPECT_FALSE(missing.valid());
+}
+
+TEST(elfxplore, archive) {
+  const fs::path dir = create_temporary_directory();
+
+  const FileSystemGuard g(dir);
+  const fs::path a_c = dir / "a.c";
+  const fs::path b_c = dir / "a_source_file_with_a_long_name.c";
+  const fs::path a_o = dir / "a.o";
+  const fs::path b_o = dir / "a_source_file_with_a_long_name.o";
+  const fs::path regular = dir / "libregular.a";
+  const fs::path thin = dir / "libthin.a";
+
+  write_file(a_c, "int a() { return 0; }");
+  write_file(b_c, "int a(); static int b() { return a(); } int c() { return b(); }");
+
+  const std::string cmd = "gcc -c -o " + a_o.string() + " " + a_c.string()
+      + " && gcc -c -o " + b_o.string() + " " + b_c.string()
+      + " && cd " + dir.string()
+      + " && ar qc " + regular.string() + " a.o a_source_file_with_a_long_name.o"
+      + " && ar qcT " + thin.string() + " a.o a_source_file_with_a_long_name.o";
+  ASSERT_EQ(system(cmd.c_str()), 0);
+
+  for(const fs::path& path : {regular, thin}) {
+    const Archive archive(path.string());
+
+    EXPECT_EQ(archive.thin(), path == thin);
+    ASSERT_EQ(archive.members().size(), 2UL);
+    EXPECT_EQ(archive.members()[0].name, "a.o");
+    EXPECT_EQ(archive.members()[1].name, "a_source_file_with_a_long_name.o");
+
+    ASSERT_TRUE(archive.has_index());
+    ASSERT_NE(archive.member_defining("a"), nullptr);
+    EXPECT_EQ(archive.member_defining("a")->name, "a.o");
+    ASSERT_NE(archive.member_defining("c"), nullptr);
+    EXPECT_EQ(archive.member_defining("c")->name, "a_source_file_with_a_long_name.o");
+    EXPECT_EQ(archive.member_defining("b"), nullptr);
+
+    const Archive::Member& member = archive.members()[1];
+    ArtifactSymbols symbols;
+    elf::read_symbols(member.data, member.size, symbols);
+    EXPECT_THAT(symbols.undefined, ContainsSymbol("a"));
+    EXPECT_THAT(symbols.internal, ContainsSymbol("b"));
+    EXPECT_THAT(symbols.external, ContainsSymbol("c"));
+  }
+}
+
+TEST(elfxplore, parse_nm_output) {
+  const std::string long_name(100000, 'x');
+
+  std::string output = "0000000000001139 000000000000000b T a\n"
+                       "                 U b\n"
+                       "0000000000001139 000000000000000b t .LC0\n"
+                       "ffffffffffffff00 00000000000000f0 D " + long_name + "\n";
+  for(int i = 0; i < 5000; ++i)
+    output += "                 U filler_" + std::to_string(i) + "\n";
+  output += "0000000000002000 0000000000000010 T c";
+
+  enum { stream, view, blocks };
+  for(const int input : {stream, view, blocks}) {
+    SymbolReferenceSet symbols;
+    if (input == stream) {
+      std::istringstream in(output);
+      parse_nm_output(in, symbols);
+    } else if (input == view) {
+      parse_nm_output(std::string_view(output), symbols);
+    } else {
+      // As read from a pipe, lines are split across blocks.
+      NmOutputParser parser(symbols);
+      for(size_t offset = 0; offset < output.size(); offset += 4093)
+        parser.feed(std::string_view(output).substr(offset, 4093));
+      parser.finish();
+    }
+
+    EXPECT_EQ(symbols.size(), 5004UL);
+    EXPECT_THAT(symbols, ContainsSymbol("a"));
+    EXPECT_THAT(symbols, ContainsSymbol("b"));
+    EXPECT_THAT(symbols, ContainsSymbol("c"));
+    EXPECT_THAT(symbols, ContainsSymbol(long_name));
+    EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol(".LC0")));
+
+    auto a = std::find_if(symbols.begin(), symbols.end(), [](const SymbolReference& s){ return s.name == "a"; });
+    ASSERT_NE(a, symbols.end());
+    EXPECT_EQ(a->type, 'T');
+    EXPECT_EQ(a->address, 0x1139);
+    EXPECT_EQ(a->size, 11);
+
+    auto b = std::find_if(symbols.begin(), symbols.end(), [](const SymbolReference& s){ return s.name == "b"; });
+    ASSERT_NE(b, symbols.end());
+    EXPECT_EQ(b->type, 'U');
+    EXPECT_EQ(b->address, -1);
+  }
+
+  // Parsing stops at the first empty line.
+  {
+    SymbolReferenceSet symbols;
+    parse_nm_output(std::string_view("                 U a\n\n                 U b\n"), symbols);
+    EXPECT_THAT(symbols, ContainsSymbol("a"));
+    EXPECT_THAT(symbols, ::testing::Not(ContainsSymbol("b")));
+  }
+}
+
+TEST(elfxplore, symbol_reference_set_move) {
+  SymbolReferenceSet from;
+  from.emplace("a", 'T', 0, 1);
+
+  SymbolReferenceSet to(std::move(from));
+  EXPECT_THAT(to, ContainsSymbol("a"));
+
+  // The moved-from sets are empty and usable.
+  EXPECT_TRUE(from.empty());
+  from.emplace("b", 'U', -1, 0);
+  EXPECT_THAT(from, ContainsSymbol("b"));
+
+  SymbolReferenceSet assigned;
+  assigned = std::move(to);
+  EXPECT_THAT(assigned, ContainsSymbol("a"));
+  EXPECT_TRUE(to.empty());
+  to.emplace("c", 'T', 0, 1);
+  EXPECT_EQ(to.size(), 1UL);
+  EXPECT_EQ(assigned.size(), 1UL);
+}
+
+TEST(elfxplore, bounded_queue) {
+  BoundedQueue<int> queue(2);
+
+  std::thread producer([&queue]{
+    for(int i = 0; i < 10; ++i)
+      queue.push(int(i));
+    queue.close();
+  });
+
+  std::vector<int> received, batch;
+  std::chrono::steady_clock::duration waited;
+  for(;;) {
+    batch.clear();
+    const size_t depth = queue.pop(batch, 3, waited);
+    EXPECT_LE(depth, queue.capacity());
+    EXPECT_LE(batch.size(), 2UL);
+    if (batch.empty())
+      break;
+    received.insert(received.end(), batch.begin(), batch.end());
+  }
+
+  producer.join();
+
+  EXPECT_THAT(received, ::testing::ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+
+  // Nothing is accepted once aborted, producers must not block.
+  queue.abort();
+  queue.push(42);
+  batch.clear();
+  EXPECT_EQ(queue.pop(batch, 1, waited), 0UL);
+  EXPECT_TRUE(batch.empty());
+}
+
+TEST(elfxplore, process) {
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+
+  {
+    Process p(std::vector<std::string>{"sh", "-c", "pwd; echo error >&2; exit 3"}, dir.string());
+    std::string out, err;
+    p.communicate(&out, &err);
+    EXPECT_EQ(out, fs::canonical(dir).string() + "\n");
+    EXPECT_EQ(err, "error\n");
+    EXPECT_EQ(p.wait(), 3);
+  }
+
+  {
+    Process p("sh -c \"echo 'a b'; kill -9 $$\"", {}, Process::output::pipe, Process::output::null);
+    EXPECT_EQ(p.err(), -1);
+
+    PipeStream out(p.out());
+    std::string line;
+    EXPECT_TRUE(std::getline(out, line));
+    EXPECT_EQ(line, "a b");
+    EXPECT_EQ(p.wait(), 128 + 9);
+  }
+
+  const size_t spawned = spawn_stats().count;
+  EXPECT_THROW(Process("elfxplore-missing-executable"), std::system_error);
+  EXPECT_EQ(spawn_stats().count, spawned + 1);
+}
+
+TEST(elfxplore, process_reactor) {
+  ProcessReactor reactor(2);
+
+  // Four children with a budget of two run in two rounds.
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::future<int>> sleeping;
+  for(int i = 0; i < 4; ++i)
+    sleeping.push_back(reactor.spawn({"sleep", "0.2"}, {}, nullptr, nullptr));
+  for(auto& f : sleeping)
+    EXPECT_EQ(f.get(), 0);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(400));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(700));
+
+  // Reaped while a grandchild keeps its stdout open, the budget is released once the pipe is closed.
+  std::string background;
+  auto orphaned = reactor.spawn({"sh", "-c", "(sleep 0.2; echo late) & exit 3"}, {},
+                                [&background](std::string_view buffer){ background.append(buffer); }, nullptr);
+  EXPECT_EQ(orphaned.get(), 3);
+  EXPECT_EQ(background, "late\n");
+
+  std::string out;
+  auto streamed = reactor.spawn({"sh", "-c", "seq 1 3; echo error >&2; exit 2"}, {},
+                                [&out](std::string_view buffer){ out.append(buffer); }, nullptr);
+  EXPECT_EQ(streamed.get(), 2);
+  EXPECT_EQ(out, "1\n2\n3\n");
+
+  const ProcessResult result = reactor.run("sh -c \"echo 'a b'; echo error >&2\"").get();
+  EXPECT_EQ(result.out, "a b\n");
+  EXPECT_EQ(result.err, "error\n");
+  EXPECT_EQ(result.code, 0);
+
+  auto missing = reactor.run("elfxplore-missing-executable");
+  EXPECT_THROW(missing.get(), std::system_error);
+}
+
+TEST(elfxplore, symbol_references_migration) {
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+  const std::string file = (dir / "db.sqlite").string();
+
+  {
+    // Layout before schema versioning, without archive members.
+    SQLite::Database db(file, SQLite::OPEN_CREATE | SQLite::OPEN_READWRITE);
+    db.exec(R"(
+create table "artifacts" ("id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "name" VARCHAR(256) NOT NULL, "type" VARCHAR(16) NOT NULL, "generating_command_id" INTEGER DEFAULT NULL);
+create table "symbols" ("id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "name" TEXT NOT NULL, "dname" TEXT NOT NULL);
+create table "symbol_references" (
+  "id" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,
+  "artifact_id" INTEGER NOT NULL REFERENCES "artifacts",
+  "symbol_id" INTEGER NOT NULL REFERENCES "symbols",
+  "category" VARCHAR(16) NOT NULL,
+  "type" VARCHAR(1) NOT NULL,
+  "size" INTEGER DEFAULT NULL
+);
+create index "symbol_reference_by_symbol" on "symbol_references" ("symbol_id");
+insert into artifacts (name, type) values ("liba.so", "shared");
+insert into symbols (name, dname) values ("a", "a"), ("b", "b");
+insert into symbol_references (artifact_id, symbol_id, category, type, size) values
+  (1, 1, "external", "T", 11), (1, 2, "undefined", "U", 0), (1, 2, "undefined", "U", 0);
+)");
+  }
+
+  Database2 db(file);
+
+  EXPECT_EQ(db.count_symbol_references(), 2);
+  EXPECT_THAT(db.undefined_symbols(1), ::testing::ElementsAre(2));
+
+  const auto locations = db.resolve_symbols({1, 2, 3});
+  ASSERT_EQ(locations.size(), 1UL);
+  EXPECT_THAT(locations.at(1), ::testing::ElementsAre("liba.so"));
+
+  auto stm = db.statement("select category, type, size, member_id from symbol_references where symbol_id = 1");
+  ASSERT_TRUE(stm.executeStep());
+  EXPECT_EQ(stm.getColumn(0).getInt(), external_symbol);
+  EXPECT_EQ(stm.getColumn(1).getInt(), 'T');
+  EXPECT_EQ(stm.getColumn(2).getInt(), 11);
+  EXPECT_EQ(stm.getColumn(3).getInt(), 0);
+
+  auto version = db.statement("PRAGMA user_version");
+  EXPECT_EQ(Database2::get_id(version), Database2::schema_version);
+
+  EXPECT_EQ(symbol_category("internal"), internal_symbol);
+  EXPECT_STREQ(symbol_category_name(undefined_symbol), "undefined");
+  EXPECT_THROW(symbol_category("weak"), std::invalid_argument);
+}
+
+TEST(elfxplore, symbol_extractor_failure) {
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+
+  Database2 db(":memory:");
+  for(int i = 0; i < 8; ++i) {
+    const fs::path source = dir / ("s" + std::to_string(i) + ".c");
+    const fs::path object = dir / ("s" + std::to_string(i) + ".o");
+    write_file(source, ("int f" + std::to_string(i) + "() { return 0; }").c_str());
+    ASSERT_EQ(system(("gcc -c -o " + object.string() + " " + source.string()).c_str()), 0);
+    db.create_artifact(object.string(), "object");
+  }
+
+  SQLite::Transaction transaction(db.database());
+
+  // The writer fails in the middle of its first batch.
+  size_t written = 0;
+  SymbolExtractor extractor(2);
+  extractor.notifyStep = [&written](const Artifact&, const SymbolExtractionStatus&) {
+    if (++written == 2)
+      throw std::runtime_error("write failed");
+  };
+
+  EXPECT_THROW(extractor.run(db), std::runtime_error);
+
+  // The batch is rolled back and its savepoint released.
+  EXPECT_EQ(db.count_symbol_references(), 0);
+  EXPECT_THROW(db.database().exec("release symbol_batch;"), std::exception);
+}
+
+TEST(elfxplore, statement_cache) {
+  Database2 db(":memory:");
+  db.create_artifact("liba.so", "shared");
+  db.create_artifact("libb.so", "shared");
+  db.create_artifact("app", "executable");
+  db.create_dependency(3, 1);
+  db.create_dependency(3, 2);
+
+  SQLite::Statement& first = db.build_get_depend_stm("dependency_id", "dependee_id", {"shared"}, {});
+  first.bind(1, 3LL);
+  ASSERT_TRUE(first.executeStep());
+
+  // Same text: the statement is reused, reset and without bindings.
+  SQLite::Statement& second = db.build_get_depend_stm("dependency_id", "dependee_id", {"shared"}, {});
+  EXPECT_EQ(&first, &second);
+  EXPECT_TRUE(Database2::get_ids(second).empty());
+  second.bind(1, 3LL);
+  EXPECT_THAT(Database2::get_ids(second), ::testing::ElementsAre(1, 2));
+
+  EXPECT_EQ(db.statement_cache_stats().misses, 1UL);
+  EXPECT_EQ(db.statement_cache_stats().hits, 1UL);
+
+  // The least recently used statement is prepared again once evicted.
+  for(size_t i = 0; i < Database2::statement_cache_size; ++i)
+    db.cached_statement("select " + std::to_string(i));
+  db.build_get_depend_stm("dependency_id", "dependee_id", {"shared"}, {});
+
+  EXPECT_EQ(db.statement_cache_stats().misses, Database2::statement_cache_size + 2);
+  EXPECT_EQ(db.statement_cache_stats().hits, 1UL);
+}
+
+TEST(elfxplore, connection_pool) {
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+  const std::string file = (dir / "db.sqlite").string();
+
+  {
+    Database2 db(file);
+    db.create_artifact("liba.so", "shared");
+  }
+
+  Database2 db(file, OpenMode::read_only);
+  EXPECT_TRUE(db.read_only());
+  EXPECT_EQ(db.artifact_id_by_name("liba.so"), 1);
+  EXPECT_THROW(db.create_artifact("libb.so", "shared"), SQLite::Exception);
+
+  // Several read-only connections at once.
+  ConnectionPool pool(db);
+  {
+    ConnectionPool::Lease a = pool.acquire(), b = pool.acquire();
+    EXPECT_NE(&*a, &*b);
+    EXPECT_TRUE(b->read_only());
+    EXPECT_EQ(b->artifact_name_by_id(1), "liba.so");
+  }
+  EXPECT_EQ(pool.size(), 2UL);
+
+  // A read-write database is lent to one thread at a time.
+  Database2 rw(":memory:");
+  ConnectionPool shared(rw);
+  EXPECT_EQ(&*shared.acquire(), &rw);
+  EXPECT_EQ(&*shared.acquire(), &rw);
+  EXPECT_EQ(shared.size(), 1UL);
+}
+
+TEST(elfxplore, checkpoints) {
+  Database2 db(":memory:");
+
+  EXPECT_FALSE(db.checkpoint_due());
+  db.set_checkpoint_interval(2, std::chrono::seconds(0));
+
+  {
+    SQLite::Transaction transaction(db.database());
+
+    db.create_artifact("liba.so", "shared");
+    EXPECT_FALSE(db.checkpoint_due());
+    EXPECT_TRUE(db.checkpoint_due());
+    db.set_progress("extract", 1);
+    db.checkpoint();
+    EXPECT_FALSE(db.checkpoint_due());
+
+    db.create_artifact("libb.so", "shared");
+    db.clear_progress("extract");
+  } // Rolled back up to the checkpoint.
+
+  EXPECT_EQ(db.checkpoints(), 1UL);
+  EXPECT_EQ(db.count_artifacts(), 1);
+  EXPECT_EQ(db.get_progress("extract"), 1);
+}
+
+TEST(elfxplore, parse_compile_commands) {
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+  write_file(dir / "object.o", "");
+  write_file(dir / "other.o", "");
+
+  std::istringstream in(R"([
+  {
+    "directory": ")" + dir.string() + R"(",
+    "command": "gcc -o object.o -c \"source file.c\"",
+    "file": "source file.c",
+    "extra": {"nested": [1, -2.5e3, true, null, {"a": "\u00e9\ud83d\ude00"}]}
+  },
+  {
+    "arguments": ["gcc", "-DNAME=\"it's\"", "-o", "other.o", "-c", "other.c"],
+    "directory": ")" + dir.string() + R"("
+  }
+])");
+
+  std::vector<CompilationCommand> commands;
+  parse_compile_commands(in, [&commands](size_t, const std::string&, const CompilationCommand& command){
+    commands.push_back(command);
+  });
+
+  ASSERT_EQ(commands.size(), 2UL);
+  EXPECT_EQ(commands[0].directory, dir.string());
+  EXPECT_EQ(commands[0].executable, "gcc");
+  EXPECT_EQ(commands[0].output, (dir / "object.o").string());
+  EXPECT_EQ(commands[1].executable, "gcc");
+  EXPECT_EQ(commands[1].output, (dir / "other.o").string());
+  EXPECT_THAT(shellwords::shellsplit(commands[1].args),
+              ::testing::ElementsAre(R"(-DNAME="it's")", "-o", "other.o", "-c", "other.c"));
+
+  std::istringstream truncated(R"([{"directory": ")" + dir.string() + R"(", "command": "gcc -o object.o -c a.c"}, {"directory")");
+  size_t count = 0;
+  EXPECT_THROW(parse_compile_commands(truncated, [&count](size_t, const std::string&, const CompilationCommand&){ ++count; }),
+               std::runtime_error);
+  EXPECT_EQ(count, 1UL);
+
+  std::istringstream no_directory(R"([{"command": "gcc -o object.o -c a.c", "file": "a.c"}])");
+  EXPECT_THROW(parse_compile_commands(no_directory, [](size_t, const std::string&, const CompilationCommand&){}),
+               std::runtime_error);
+}
+
+TEST(elfxplore, parse_commands) {
+  const fs::path dir = create_temporary_directory();
+  const FileSystemGuard g(dir);
+  write_file(dir / "object.o", "");
+
+  // Several chunks, notified in order.
+  std::ostringstream list;
+  for(size_t i = 0; i < 5000; ++i)
+    list << dir.string() << " gcc -o object.o -c source" << i << ".c\n";
+
+  std::istringstream in(list.str());
+  size_t count = 0;
+  parse_commands(in, [&count, &dir](size_t item, const std::string& line, const CompilationCommand& command){
+    EXPECT_EQ(item, count);
+    EXPECT_EQ(command.args, "-o object.o -c source" + std::to_string(item) + ".c");
+    EXPECT_EQ(line, dir.string() + " gcc " + command.args);
+    EXPECT_EQ(command.output, (dir / "object.o").string());
+    ++count;
+  }, 4);
+
+  EXPECT_EQ(count, 5000UL);
+
+  // A parsing error stops the workers once the chunks of 1024 commands before it have been notified.
+  list << dir.string() << " gcc -o missing.o -c source.c\n";
+  for(size_t i = 0; i < 3000; ++i)
+    list << dir.string() << " gcc -o object.o -c source.c\n";
+
+  std::istringstream error(list.str());
+  count = 0;
+  EXPECT_THROW(parse_commands(error, [&count](size_t, const std::string&, const CompilationCommand&){ ++count; }, 4),
+               std::exception);
+  EXPECT_EQ(count, 4096UL);
+}
+
+TEST(elfxplore, import_commands_expansion) {
+  const fs::path dir = fs::canonical(create_temporary_directory());
+  const FileSystemGuard g(dir);
+
+  const char* home = std::getenv("HOME");
+  const std::string previous_home = home ? home : "";
+  setenv("HOME", dir.c_str(), 1);
+  setenv("ELFXPLORE_TEST_DIR", dir.c_str(), 1);
+
+  // Distinct outputs, each one is expanded by wordexp() on one of the parsing threads.
+  std::ostringstream list;
+  for(size_t i = 0; i < 2000; ++i) {
+    const std::string name = "object" + std::to_string(i) + ".o";
+    write_file(dir / name, "");
+    list << dir.string() << " gcc -o " << (i % 2 ? "~/" : "'$ELFXPLORE_TEST_DIR'/") << name << " -c source.c\n";
+  }
+
+  Database2 db(":memory:");
+  CommandImporter importer(db, 4);
+  std::istringstream in(list.str());
+  importer.import_commands(in);
+
+  setenv("HOME", previous_home.c_str(), 1);
+
+  EXPECT_EQ(importer.count_inserted(), 2000UL);
+  EXPECT_EQ(db.count_artifacts(), 2000);
+  for(size_t i = 0; i < 2000; i += 499)
+    EXPECT_NE(db.artifact_id_by_name((dir / ("object" + std::to_string(i) + ".o")).string()), -1);
+}
@@ -2,16 +2,20 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <sstream>
 #include <regex>
 #include <fstream>
 #include <filesystem>
+#include <mutex>
 #include <random>
+#include <system_error>
+#include <unordered_map>
 
+#include <cxxabi.h>
 #include <wordexp.h>
 
 #include "Database2.hxx"
-#include "query-utils.hxx"
 
 namespace fs = std::filesystem;
 
@@ -19,9 +23,65 @@ namespace {
 
 std::regex so_regex(R"(.*\.so(?:\.\d+)*$)");
 
+// Resolved paths by base directory and argument, and canonical directories, for the whole program:
+// the same few directories are resolved again for each command.
+std::mutex path_cache_mutex;
+std::unordered_map<std::string, fs::path> path_cache;
+std::unordered_map<std::string, fs::path> directory_cache;
+PathCacheStats path_cache_counters;
+
+// wordexp() is not thread-safe, paths are expanded by the parallel command parsers.
+std::mutex wordexp_mutex;
+
+std::string shell_expand(const std::string& in) {
+  std::lock_guard<std::mutex> lock(wordexp_mutex);
+
+  wordexp_t wx;
+  if (wordexp(in.c_str(), &wx, 0) != 0)
+    return in;
+
+  const std::string out = wx.we_wordc > 0 ? wx.we_wordv[0] : in;
+  wordfree(&wx);
+  return out;
+}
+
+fs::path canonical_directory(const fs::path& directory) {
+  {
+    std::lock_guard<std::mutex> lock(path_cache_mutex);
+    const auto found = directory_cache.find(directory.native());
+    if (found != directory_cache.end())
+      return found->second;
+  }
+
+  fs::path out = fs::canonical(directory);
+
+  std::lock_guard<std::mutex> lock(path_cache_mutex);
+  ++path_cache_counters.directories;
+  directory_cache.emplace(directory.native(), out);
+  return out;
+}
+
+// Same result as fs::canonical(), with a single lstat() for the last component once its directory is known.
+fs::path canonical_path(const fs::path& path) {
+  const fs::path name = path.filename();
+  if (name.empty() || name == "." || name == "..")
+    return fs::canonical(path);
+
+  const fs::path out = canonical_directory(path.parent_path()) / name;
+  const fs::file_status status = fs::symlink_status(out);
+
+  if (fs::is_symlink(status))
+    return fs::canonical(out);
+
+  if (!fs::exists(status))
+    throw fs::filesystem_error("cannot make canonical path", path, std::make_error_code(std::errc::no_such_file_or_directory));
+
+  return out;
+}
+
 } // anonymous namespace
 
-bool starts_with(const std::string& str, const std::string& prefix) {
+bool starts_with(std::string_view str, std::string_view prefix) {
   if (str.length() >= prefix.length()) {
     return (0 == str.compare(0, prefix.length(), prefix));
   } else {
@@ -29,7 +89,7 @@ bool starts_with(const std::string& str, const std::string& prefix) {
   }
 }
 
-bool ends_with(const std::string& str, const std::string& suffix) {
+bool ends_with(std::string_view str, std::string_view suffix) {
   if (str.length() >= suffix.length()) {
     return (0 == str.compare(str.length() - suffix.length(), suffix.length(), suffix));
   } else {
@@ -38,21 +98,44 @@ bool ends_with(const std::string& str, const std::string& suffix) {
 }
 
 std::filesystem::path expand_path(const std::string& in, const std::filesystem::path& base) {
-  wordexp_t wx;
-  wordexp(in.c_str(), &wx, 0);
-  std::filesystem::path out(wx.we_wordv[0]);
-  wordfree(&wx);
+  // Looked up before expanding, a hit costs no wordexp(). Absolute paths resolve the same from any base.
+  std::string key = starts_with(in, "/") ? std::string() : base.native();
+  key += '\0';
+  key += in;
+
+  {
+    std::lock_guard<std::mutex> lock(path_cache_mutex);
+    const auto found = path_cache.find(key);
+    if (found != path_cache.end()) {
+      ++path_cache_counters.hits;
+      return found->second;
+    }
+  }
+
+  // Arguments are already split, only variables and home directories are left to expand.
+  std::filesystem::path out(in.find_first_of("$~") != std::string::npos ? shell_expand(in) : in);
 
   if (out.is_relative())
     out = base / out;
 
-  return std::filesystem::canonical(out);
+  // Paths which cannot be resolved are not cached, they may exist later.
+  out = canonical_path(out);
+
+  std::lock_guard<std::mutex> lock(path_cache_mutex);
+  ++path_cache_counters.misses;
+  path_cache.emplace(std::move(key), out);
+  return out;
 }
 
 std::filesystem::path expand_path(const std::string& in) {
   return expand_path(in, std::filesystem::current_path());
 }
 
+PathCacheStats path_cache_stats() {
+  std::lock_guard<std::mutex> lock(path_cache_mutex);
+  return path_cache_counters;
+}
+
 const char* get_library_type(const std::string& value) {
   if (ends_with(value, ".a")) return "static";
   if (std::regex_match(value, so_regex)) return "shared";
@@ -105,21 +188,32 @@ std::string trim_copy(std::string s) {
   return s;
 }
 
+std::string demangle(const std::string& name) {
+  int status;
+  char* dname = abi::__cxa_demangle(name.c_str(), 0, 0, &status);
+
+  std::string out;
+  if (status == 0)
+    out = dname;
+
+  free(dname);
+  return out;
+}
+
 std::string symbol_hname(const std::string& name, const std::string& dname) {
-  return dname.empty() ? name : dname;
+  if (!dname.empty())
+    return dname;
+
+  const std::string demangled = starts_with(name, "_Z") ? demangle(name) : std::string();
+  return demangled.empty() ? name : demangled;
 }
 
 std::map<long long, std::string> get_symbol_hnames(Database2& db, const std::vector<long long>& ids)
 {
   std::map<long long, std::string> names;
 
-  std::ostringstream ss;
-  ss << R"(
-select id, name, dname
-from symbols
-where id in )" << in_expr(ids);
-
-  SQLite::Statement stm = db.statement(ss.str());
+  SQLite::Statement& stm = db.cached_statement("select id, name, dname from symbols where id in (select value from json_each(?))");
+  Database2::bind_ids(stm, 1, ids);
 
   while(stm.executeStep()) {
     names.emplace(
@@ -143,6 +237,38 @@ std::vector<std::string> split(std::string str, const char delim) {
   return tokens;
 }
 
+std::string shell_quote(std::string_view arg) {
+  const bool plain = !arg.empty() && std::all_of(arg.begin(), arg.end(), [](const char c){
+    return std::isalnum(static_cast<unsigned char>(c)) || std::strchr("-_./=+,:@%", c) != nullptr;
+  });
+
+  if (plain)
+    return std::string(arg);
+
+  std::string quoted = "'";
+  for(const char c : arg) {
+    if (c == '\'')
+      quoted += "'\\''";
+    else
+      quoted += c;
+  }
+  quoted += '\'';
+
+  return quoted;
+}
+
+std::string shell_join(const std::vector<std::string>& argv) {
+  std::string line;
+
+  for(const std::string& arg : argv) {
+    if (!line.empty())
+      line += ' ';
+    line += shell_quote(arg);
+  }
+
+  return line;
+}
+
 void wc(std::istream& in, size_t& c, size_t& l) {
   for(std::string line; std::getline(in, line); ) {
     c += line.size();
@@ -2,19 +2,30 @@
 #define UTILS_HXX
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <filesystem>
 
 class Database2;
 
-bool starts_with(const std::string& str, const std::string& prefix);
-bool ends_with(const std::string& str, const std::string& suffix);
+bool starts_with(std::string_view str, std::string_view prefix);
+bool ends_with(std::string_view str, std::string_view suffix);
 
+// Canonical path of in relative to base, after expanding variables and ~ when it contains $ or ~.
+// Results and resolved directories are cached for the lifetime of the program.
 std::filesystem::path expand_path(const std::string& in, const std::filesystem::path& base);
 
 std::filesystem::path expand_path(const std::string& in);
 
+struct PathCacheStats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t directories = 0;
+};
+
+PathCacheStats path_cache_stats();
+
 const char* get_library_type(const std::string& value);
 
 const char* get_output_type(const std::string& value);
@@ -35,12 +46,22 @@ std::string rtrim_copy(std::string s);
 
 std::string trim_copy(std::string s);
 
+// Demangled C++ name, empty if name is not a mangled C++ name.
+std::string demangle(const std::string& name);
+
+// Falls back to demangling name when dname has not been filled yet.
 std::string symbol_hname(const std::string& name, const std::string& dname);
 
 std::map<long long, std::string> get_symbol_hnames(Database2& db, const std::vector<long long>& ids);
 
 std::vector<std::string> split(std::string str, const char delim);
 
+// Single-quotes arg when it contains characters interpreted by shellwords::shellsplit().
+std::string shell_quote(std::string_view arg);
+
+// Command line split back into argv by shellwords::shellsplit(), arguments are single-quoted when needed.
+std::string shell_join(const std::vector<std::string>& argv);
+
 void wc(std::istream& in, size_t& c, size_t& l);
 
 void wc(const std::string& file, size_t& c, size_t& l);